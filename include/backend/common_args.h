@@ -24,6 +24,11 @@ void get_option_link_args(struct workspace *wk,
 	const struct obj_build_target *tgt,
 	obj args_id);
 
+bool build_target_split_dwarf(struct workspace *wk,
+	struct obj_compiler *comp,
+	const struct project *proj,
+	const struct obj_build_target *tgt);
+
 bool setup_compiler_args(struct workspace *wk,
 	const struct obj_build_target *tgt,
 	const struct project *proj,
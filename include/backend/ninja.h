@@ -11,6 +11,11 @@
 struct write_tgt_ctx {
 	FILE *out;
 	const struct project *proj;
+	struct sbuf *compdb;
+	struct hash *argsets;
+	uint32_t rsp_threshold;
+	obj dwp_cmd;
+	bool thin_archives;
 	bool wrote_default;
 };
 
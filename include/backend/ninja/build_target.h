@@ -9,4 +9,7 @@
 struct write_tgt_ctx;
 
 bool ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *ctx);
+bool ninja_tgt_dwp(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt);
+bool ninja_find_dwp(struct workspace *wk, obj *res);
+bool ninja_tgt_add_dwp(struct workspace *wk, struct obj_build_target *tgt);
 #endif
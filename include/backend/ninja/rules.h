@@ -7,6 +7,21 @@
 #define MUON_BACKEND_NINJA_RULES_H
 #include "lang/workspace.h"
 
-bool
-ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony, obj compiler_rule_arr);
+// Every compiler and linker rule has a variant with this suffix that passes
+// the bulk of its arguments in a response file.
+#define NINJA_RSP_RULE_SUFFIX "_rsp"
+// Static linker rules with this suffix create thin archives.
+#define NINJA_THIN_RULE_SUFFIX "_thin"
+#define NINJA_LTO_POOL "lto_pool"
+
+bool ninja_write_rules(FILE *out,
+	struct workspace *wk,
+	struct project *main_proj,
+	bool need_phony,
+	bool need_lto_pool,
+	bool thin_archives,
+	obj compiler_rule_arr);
+uint32_t ninja_rsp_threshold(struct workspace *wk);
+bool ninja_thin_archives(struct workspace *wk);
+bool ninja_tgt_lto_pool(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt);
 #endif
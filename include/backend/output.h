@@ -9,7 +9,8 @@
 #include "lang/workspace.h"
 
 struct output_path {
-	const char *private_dir, *summary, *tests, *install, *compiler_check_cache, *option_info;
+	const char *private_dir, *summary, *tests, *install, *compiler_check_cache, *option_info,
+		*find_cmd_cache, *setup_cache, *time_report, *regenerate_deps, *subproject_workers, *subninja;
 };
 
 extern const struct output_path output_path;
@@ -18,4 +19,11 @@ typedef bool((with_open_callback)(struct workspace *wk, void *ctx, FILE *out));
 
 FILE *output_open(const char *dir, const char *name);
 bool with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb);
+bool with_open_replaced(const char *dir,
+	const char *name,
+	struct workspace *wk,
+	void *ctx,
+	with_open_callback cb,
+	bool *replaced);
+bool output_write_if_changed(struct workspace *wk, const char *path, const struct sbuf *contents);
 #endif
@@ -0,0 +1,27 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_BACKEND_PCH_H
+#define MUON_BACKEND_PCH_H
+
+#include "lang/workspace.h"
+
+struct pch {
+	obj header; // obj_string, absolute
+	obj output; // obj_string, relative to the build root
+	obj src; // obj_file, msvc only
+	obj object; // obj_string, msvc only, relative to the build root
+	bool msvc, generated_src;
+};
+
+bool pch_get(struct workspace *wk,
+	const struct project *proj,
+	const struct obj_build_target *tgt,
+	enum compiler_language lang,
+	struct pch *res);
+obj pch_use_args(struct workspace *wk, const struct project *proj, const struct pch *pch, enum compiler_language lang);
+obj pch_create_args(struct workspace *wk, const struct project *proj, const struct pch *pch, enum compiler_language lang);
+bool pch_write_src(struct workspace *wk, const struct pch *pch);
+#endif
@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_BACKEND_UNITY_H
+#define MUON_BACKEND_UNITY_H
+
+#include "lang/workspace.h"
+
+bool unity_enabled(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt);
+bool unity_batches(struct workspace *wk, const struct obj_build_target *tgt, obj *batches, obj *unity_srcs);
+bool unity_write_batches(struct workspace *wk, obj batches);
+#endif
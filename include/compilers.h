@@ -166,6 +166,7 @@ typedef const struct args *((*compiler_get_arg_func_ns)(TOOLCHAIN_SIG_ns));
 	_(output, compiler, TOOLCHAIN_PARAMS_1s)             \
 	_(optimization, compiler, TOOLCHAIN_PARAMS_1i)       \
 	_(debug, compiler, TOOLCHAIN_PARAMS_0)               \
+	_(split_dwarf, compiler, TOOLCHAIN_PARAMS_0)         \
 	_(warning_lvl, compiler, TOOLCHAIN_PARAMS_1i)        \
 	_(warn_everything, compiler, TOOLCHAIN_PARAMS_0)     \
 	_(werror, compiler, TOOLCHAIN_PARAMS_0)              \
@@ -187,11 +188,16 @@ typedef const struct args *((*compiler_get_arg_func_ns)(TOOLCHAIN_SIG_ns));
 	_(object_ext, compiler, TOOLCHAIN_PARAMS_0)          \
 	_(deps_type, compiler, TOOLCHAIN_PARAMS_0)           \
 	_(coverage, compiler, TOOLCHAIN_PARAMS_0)            \
+	_(pch_type, compiler, TOOLCHAIN_PARAMS_0)            \
+	_(pch_create, compiler, TOOLCHAIN_PARAMS_2s)         \
+	_(pch_use, compiler, TOOLCHAIN_PARAMS_2s)            \
+	_(rsp, compiler, TOOLCHAIN_PARAMS_1s)                \
 	_(std_supported, compiler, TOOLCHAIN_PARAMS_1s)
 
 #define FOREACH_LINKER_ARG(_)                                \
 	_(lib, linker, TOOLCHAIN_PARAMS_1s)                  \
 	_(debug, linker, TOOLCHAIN_PARAMS_0)                 \
+	_(gdb_index, linker, TOOLCHAIN_PARAMS_0)             \
 	_(as_needed, linker, TOOLCHAIN_PARAMS_0)             \
 	_(no_undefined, linker, TOOLCHAIN_PARAMS_0)          \
 	_(start_group, linker, TOOLCHAIN_PARAMS_0)           \
@@ -207,14 +213,18 @@ typedef const struct args *((*compiler_get_arg_func_ns)(TOOLCHAIN_SIG_ns));
 	_(fatal_warnings, linker, TOOLCHAIN_PARAMS_0)        \
 	_(whole_archive, linker, TOOLCHAIN_PARAMS_1s)        \
 	_(enable_lto, linker, TOOLCHAIN_PARAMS_0)            \
+	_(lto_threads, linker, TOOLCHAIN_PARAMS_1i)          \
 	_(input_output, linker, TOOLCHAIN_PARAMS_2s)         \
 	_(always, linker, TOOLCHAIN_PARAMS_0)                \
+	_(rsp, linker, TOOLCHAIN_PARAMS_1s)                  \
 	_(coverage, linker, TOOLCHAIN_PARAMS_0)
 
 #define FOREACH_STATIC_LINKER_ARG(_)                        \
 	_(base, static_linker, TOOLCHAIN_PARAMS_0)          \
+	_(base_thin, static_linker, TOOLCHAIN_PARAMS_0)     \
 	_(input_output, static_linker, TOOLCHAIN_PARAMS_2s) \
-	_(always, static_linker, TOOLCHAIN_PARAMS_0)
+	_(always, static_linker, TOOLCHAIN_PARAMS_0)        \
+	_(rsp, static_linker, TOOLCHAIN_PARAMS_1s)
 
 struct language {
 	bool is_header;
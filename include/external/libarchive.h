@@ -8,8 +8,15 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 extern const bool have_libarchive;
 
-bool muon_archive_extract(const char *buf, size_t size, const char *dest_path);
+/*
+ * Returns the number of bytes made available in *buf, 0 at the end of the
+ * input, or -1 on error.  *buf must stay valid until the next call.
+ */
+typedef int64_t((*muon_archive_read_cb)(void *ctx, const void **buf));
+
+bool muon_archive_extract(muon_archive_read_cb read_cb, void *ctx, const char *dest_path);
 #endif
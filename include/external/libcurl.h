@@ -14,4 +14,9 @@ extern const bool have_libcurl;
 void muon_curl_init(void);
 void muon_curl_deinit(void);
 bool muon_curl_fetch(const char *url, uint8_t **buf, uint64_t *len);
+
+struct muon_curl_stream;
+struct muon_curl_stream *muon_curl_stream_open(const char *url);
+int64_t muon_curl_stream_read(struct muon_curl_stream *stream, const void **buf);
+bool muon_curl_stream_close(struct muon_curl_stream *stream);
 #endif
@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_FIND_CMD_CACHE_H
+#define MUON_FIND_CMD_CACHE_H
+
+#include "lang/workspace.h"
+
+bool find_cmd_cache_load(struct workspace *wk);
+bool find_cmd_cache_dump(struct workspace *wk, void *_ctx, FILE *out);
+bool find_cmd_cached(struct workspace *wk, struct sbuf *buf, const char *cmd);
+#endif
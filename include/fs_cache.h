@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_FS_CACHE_H
+#define MUON_FS_CACHE_H
+
+#include "lang/workspace.h"
+#include "platform/filesystem.h"
+
+bool fs_cache_exists(struct workspace *wk, const char *path);
+bool fs_cache_file_exists(struct workspace *wk, const char *path);
+bool fs_cache_dir_exists(struct workspace *wk, const char *path);
+bool fs_cache_size(struct workspace *wk, const char *path, uint64_t *size);
+bool fs_cache_is_samepath(struct workspace *wk, const char *a, const char *b);
+bool fs_cache_dir_foreach(struct workspace *wk, const char *path, void *_ctx, fs_dir_foreach_cb cb);
+void fs_cache_forget(struct workspace *wk, const char *path);
+void fs_cache_invalidate(struct workspace *wk);
+#endif
@@ -20,6 +20,10 @@ enum eval_mode {
 	eval_mode_default,
 	eval_mode_repl,
 	eval_mode_first,
+	// Reuse code compiled by a previous eval of a source with the same
+	// label.  Only valid for sources that never change, e.g. embedded
+	// scripts.
+	eval_mode_cache_code = 1 << 2,
 };
 
 bool eval_project(struct workspace *wk,
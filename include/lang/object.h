@@ -202,6 +202,7 @@ enum build_tgt_flags {
 	build_tgt_flag_visibility = 1 << 4,
 	build_tgt_flag_installed = 1 << 5,
 	build_tgt_flag_pie = 1 << 6,
+	build_tgt_flag_dwp = 1 << 7,
 };
 
 struct build_dep {
@@ -245,10 +246,13 @@ struct obj_build_target {
 	obj generated_pc; // obj_string
 	obj override_options; // obj_array
 	obj required_compilers; // obj_dict
+	obj pch; // obj_dict
+	obj install_target; // obj_install_target
 
 	struct build_dep dep;
 	struct build_dep dep_internal;
 
+	uint32_t project_id; // index of the project that defined this target
 	enum compiler_visibility_type visibility;
 	enum build_tgt_flags flags;
 	enum tgt_type type;
@@ -384,6 +388,7 @@ struct obj_compiler {
 	uint32_t type[3];
 	enum compiler_language lang;
 	bool linker_passthrough;
+	bool linker_gdb_index;
 };
 
 enum install_target_type {
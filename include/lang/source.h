@@ -6,6 +6,7 @@
 
 #define MUON_LANG_SOURCE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 enum source_reopen_type {
@@ -22,6 +23,9 @@ struct source {
 	// only necessary if src is NULL.  If so, this source will be re-read
 	// on error to fetch appropriate context lines.
 	enum source_reopen_type reopen_type;
+
+	// src is a mapping created by fs_read_entire_file
+	bool mapped;
 };
 
 struct source_location {
@@ -160,6 +160,9 @@ struct vm {
 	uint32_t ip, nargs, nkwargs;
 	obj scope_stack, default_scope_stack;
 	obj module_path;
+	// dict[str -> number], entry points of code compiled with
+	// eval_mode_cache_code
+	obj code_cache;
 
 	struct vm_ops ops;
 	struct vm_objects objects;
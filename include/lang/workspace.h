@@ -82,6 +82,32 @@ struct workspace {
 	obj dependency_handlers;
 	/* list[str], used for error reporting */
 	obj backend_output_stack;
+	/* PATH lookup cache for find_program(), see find_cmd_cache.c */
+	struct {
+		/* dict[dir -> [mtime, list[str]]], loaded from the previous setup */
+		obj prev_dirs;
+		/* dict[dir -> [mtime, dict[str -> str]]], validated during this setup */
+		obj dirs;
+		/* dict[str -> str | null], results for the PATH stored in env_path */
+		obj results;
+		obj env_path;
+	} find_cmd_cache;
+	/* caches validated by file mtimes, see setup_cache.c */
+	struct {
+		/* dict[key -> [list[[path, mtime]], any]] */
+		obj prev, cur;
+	} setup_cache;
+	/* filesystem queries made during this setup, see fs_cache.c */
+	struct {
+		/* dict[path -> number], flags for the queries made so far */
+		obj stat;
+		/* dict[path -> [size, dev, ino]] */
+		obj stat_res;
+		/* dict[path -> list[str]] */
+		obj dirs;
+	} fs_cache;
+	/* list[[kind, name, usec, cached]], only set for setup -t, see time_report.c */
+	obj time_report;
 	/* ----------------- */
 
 	struct vm vm;
@@ -94,6 +120,14 @@ struct workspace {
 
 	uint32_t cur_project;
 
+	/* parallel subproject evaluation for setup -j, see subproject_workers.c */
+	struct {
+		uint32_t jobs;
+		bool started;
+		/* only set in worker processes */
+		const char *parent_private;
+	} subproject_workers;
+
 #ifdef TRACY_ENABLE
 	struct {
 		bool is_master_workspace;
@@ -20,6 +20,7 @@ struct sbuf;
 bool fs_stat(const char *path, struct stat *sb);
 enum fs_mtime_result { fs_mtime_result_ok, fs_mtime_result_not_found, fs_mtime_result_err };
 enum fs_mtime_result fs_mtime(const char *path, int64_t *mtime);
+bool fs_touch(const char *path);
 bool fs_exists(const char *path);
 bool fs_file_exists(const char *path);
 bool fs_symlink_exists(const char *path);
@@ -30,12 +31,20 @@ bool fs_mkdir_p(const char *path);
 bool fs_rmdir(const char *path, bool force);
 bool fs_rmdir_recursive(const char *path, bool force);
 bool fs_read_entire_file(const char *path, struct source *src);
+// Like fs_read_entire_file, but large files may be mapped instead of read.
+bool fs_read_entire_file_mapped(const char *path, struct source *src);
 bool fs_fsize(FILE *file, uint64_t *ret);
 bool fs_fclose(FILE *file);
 FILE *fs_fopen(const char *path, const char *mode);
 bool fs_fwrite(const void *ptr, size_t size, FILE *f);
 bool fs_fread(void *ptr, size_t size, FILE *f);
 bool fs_write(const char *path, const uint8_t *buf, uint64_t buf_len);
+// Returns true if path is a file containing exactly buf.
+bool fs_file_has_content(const char *path, const uint8_t *buf, uint64_t buf_len);
+// Returns true if a and b are both files with the same contents.  a is read
+// into memory.
+bool fs_files_equal(const char *a, const char *b);
+bool fs_sha_256_file(const char *path, uint8_t hash[32]);
 bool fs_find_cmd(struct workspace *wk, struct sbuf *buf, const char *cmd);
 bool fs_has_cmd(const char *cmd);
 void fs_source_destroy(struct source *src);
@@ -46,12 +55,18 @@ bool fs_fileno(FILE *f, int *ret);
 bool fs_make_symlink(const char *target, const char *path, bool force);
 bool fs_fseek(FILE *file, size_t off);
 bool fs_ftell(FILE *file, uint64_t *res);
+// Maps the first len bytes of f copy-on-write, with a zero byte at res[len].
+// Returns false if the file can't be mapped this way, without logging an
+// error.  Used by fs_read_entire_file_mapped.
+bool fs_mmap(FILE *f, uint64_t len, const char **res);
+void fs_munmap(const char *p, uint64_t len);
 const char *fs_user_home(void);
 bool fs_is_a_tty_from_fd(int fd);
 bool fs_is_a_tty(FILE *f);
 bool fs_chmod(const char *path, uint32_t mode);
 bool fs_copy_metadata(const char *src, const char *dest);
 bool fs_remove(const char *path);
+bool fs_rename(const char *src, const char *dest);
 bool fs_has_extension(const char *path, const char *ext);
 FILE *fs_make_tmp_file(const char *name, const char *suffix, char *buf, uint32_t len);
 
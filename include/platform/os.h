@@ -36,4 +36,16 @@ uint32_t os_parallel_job_count(void);
 
 void os_set_env(const struct str *k, const struct str *v);
 const char *os_get_env(const char *k);
+
+uint32_t os_getpid(void);
+
+// Forks the current process, *pid is set to 0 in the child.  Returns false if
+// fork failed or is not supported on this platform.
+bool os_fork(uint32_t *pid);
+// Waits for any forked child to exit.  *status is set to -1 if the child did
+// not exit normally.
+bool os_wait_child(uint32_t *pid, int32_t *status);
+// Exits a forked child without running atexit handlers or flushing stdio
+// buffers inherited from the parent.
+void os_exit_child(int32_t status);
 #endif
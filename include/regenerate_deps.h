@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_REGENERATE_DEPS_H
+#define MUON_REGENERATE_DEPS_H
+
+#include "lang/workspace.h"
+
+bool regenerate_deps_dump(struct workspace *wk, void *_ctx, FILE *out);
+bool regenerate_deps_unchanged(struct workspace *wk);
+#endif
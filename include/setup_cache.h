@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_SETUP_CACHE_H
+#define MUON_SETUP_CACHE_H
+
+#include "lang/workspace.h"
+
+bool setup_cache_load(struct workspace *wk);
+bool setup_cache_dump(struct workspace *wk, void *_ctx, FILE *out);
+bool setup_cache_get(struct workspace *wk, obj key, obj *res);
+void setup_cache_set(struct workspace *wk, obj key, obj files, obj val);
+#endif
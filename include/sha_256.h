@@ -9,5 +9,42 @@
 #include <stddef.h>
 #include <stdint.h>
 
-void calc_sha_256(uint8_t hash[32], const void *input, size_t len);
+#define SHA_256_HASH_SIZE 32
+#define SHA_256_CHUNK_SIZE 64
+
+/*
+ * Streaming interface, for data that is not available all at once.  The hash
+ * is written to the buffer passed to sha_256_init() by sha_256_close().
+ */
+struct sha_256 {
+	uint8_t *hash;
+	uint8_t chunk[SHA_256_CHUNK_SIZE];
+	uint8_t *chunk_pos;
+	size_t space_left;
+	uint64_t total_len;
+	uint32_t h[8];
+};
+
+void sha_256_init(struct sha_256 *sha_256, uint8_t hash[SHA_256_HASH_SIZE]);
+void sha_256_write(struct sha_256 *sha_256, const void *data, size_t len);
+uint8_t *sha_256_close(struct sha_256 *sha_256);
+
+void calc_sha_256(uint8_t hash[SHA_256_HASH_SIZE], const void *input, size_t len);
+
+/*
+ * The block function is chosen at runtime, using cpu extensions when they
+ * are available.  Selecting an implementation manually is only useful for
+ * benchmarking and testing.
+ */
+enum sha_256_impl {
+	sha_256_impl_generic,
+	sha_256_impl_x86_sha_ni,
+	sha_256_impl_armv8_crypto,
+	sha_256_impl_count,
+};
+
+int sha_256_impl_supported(enum sha_256_impl impl);
+int sha_256_impl_select(enum sha_256_impl impl);
+enum sha_256_impl sha_256_impl_get(void);
+const char *sha_256_impl_name(enum sha_256_impl impl);
 #endif
@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_SUBPROJECT_WORKERS_H
+#define MUON_SUBPROJECT_WORKERS_H
+
+#include "lang/workspace.h"
+
+void subproject_workers_run(struct workspace *wk);
+void subproject_workers_before_command(struct workspace *wk);
+#endif
@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#ifndef MUON_TIME_REPORT_H
+#define MUON_TIME_REPORT_H
+
+#include "lang/workspace.h"
+#include "platform/timer.h"
+
+enum time_report_kind {
+	time_report_kind_subproject,
+	time_report_kind_subdir,
+	time_report_kind_dependency,
+	time_report_kind_compiler_check,
+	time_report_kind_run_command,
+	time_report_kind_count,
+};
+
+enum time_report_cached {
+	time_report_cached_na,
+	time_report_cached_hit,
+	time_report_cached_miss,
+};
+
+bool time_report_enabled(struct workspace *wk);
+void time_report_start(struct workspace *wk, struct timer *t);
+void time_report_end(struct workspace *wk, struct timer *t, enum time_report_kind kind, obj name);
+void time_report_push(struct workspace *wk,
+	enum time_report_kind kind,
+	obj name,
+	float dur,
+	enum time_report_cached cached);
+void time_report_print(struct workspace *wk, FILE *out);
+bool time_report_dump_json(struct workspace *wk, void *_ctx, FILE *out);
+#endif
@@ -19,6 +19,8 @@
 #include "backend/ninja/custom_target.c"
 #include "backend/ninja/rules.c"
 #include "backend/output.c"
+#include "backend/pch.c"
+#include "backend/unity.c"
 #include "cmd_install.c"
 #include "cmd_test.c"
 #include "coerce.c"
@@ -33,10 +35,12 @@
 #include "external/libcurl_null.c"
 #include "external/readline_builtin.c"
 #include "external/tinyjson_null.c"
+#include "find_cmd_cache.c"
 #include "formats/editorconfig.c"
 #include "formats/ini.c"
 #include "formats/lines.c"
 #include "formats/tap.c"
+#include "fs_cache.c"
 #include "functions/array.c"
 #include "functions/boolean.c"
 #include "functions/both_libs.c"
@@ -106,8 +110,12 @@
 #include "platform/path.c"
 #include "platform/run_cmd.c"
 #include "platform/uname.c"
+#include "regenerate_deps.c"
 #include "rpmvercmp.c"
+#include "setup_cache.c"
 #include "sha_256.c"
+#include "subproject_workers.c"
+#include "time_report.c"
 #include "version.c.in"
 #include "vsenv.c"
 #include "wrap.c"
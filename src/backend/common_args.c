@@ -105,6 +105,35 @@ get_buildtype(struct workspace *wk,
 	}
 }
 
+/*
+ * With b_split_dwarf, compiles that produce debug info write most of it to a
+ * .dwo file next to each object, so the linker doesn't need to process it.
+ */
+bool
+build_target_split_dwarf(struct workspace *wk,
+	struct obj_compiler *comp,
+	const struct project *proj,
+	const struct obj_build_target *tgt)
+{
+#ifdef MUON_BOOTSTRAPPED
+	if (!toolchain_compiler_split_dwarf(wk, comp)->len) {
+		return false;
+	}
+
+	obj opt;
+	get_option_value_for_tgt(wk, proj, tgt, "b_split_dwarf", &opt);
+	if (!get_obj_bool(wk, opt)) {
+		return false;
+	}
+
+	struct buildtype buildtype;
+	get_buildtype(wk, proj, tgt, &buildtype);
+	return buildtype.debug;
+#else
+	return false;
+#endif
+}
+
 static void
 get_buildtype_args(struct workspace *wk, struct obj_compiler *comp, const struct buildtype *buildtype, obj args_id)
 {
@@ -294,6 +323,10 @@ setup_optional_b_args_compiler(struct workspace *wk,
 		push_args(wk, args, toolchain_compiler_enable_lto(wk, comp));
 	}
 
+	if (build_target_split_dwarf(wk, comp, proj, tgt)) {
+		push_args(wk, args, toolchain_compiler_split_dwarf(wk, comp));
+	}
+
 	get_option_value_for_tgt(wk, proj, tgt, "b_coverage", &opt);
 	if (get_obj_bool(wk, opt)) {
 		push_args(wk, args, toolchain_compiler_coverage(wk, comp));
@@ -584,6 +617,11 @@ setup_optional_b_args_linker(struct workspace *wk,
 	get_option_value_for_tgt(wk, proj, tgt, "b_lto", &opt);
 	if (get_obj_bool(wk, opt)) {
 		push_args(wk, args, toolchain_linker_enable_lto(wk, comp));
+
+		get_option_value_for_tgt(wk, proj, tgt, "b_lto_threads", &opt);
+		if (get_obj_number(wk, opt)) {
+			push_args(wk, args, toolchain_linker_lto_threads(wk, comp, get_obj_number(wk, opt)));
+		}
 	}
 
 	get_option_value_for_tgt(wk, proj, tgt, "b_coverage", &opt);
@@ -631,6 +669,10 @@ setup_linker_args(struct workspace *wk,
 		if (buildtype.debug) {
 			push_linker_args(wk, ctx, toolchain_linker_debug(wk, ctx->compiler));
 		}
+
+		if (proj && build_target_split_dwarf(wk, ctx->compiler, proj, tgt)) {
+			push_linker_args(wk, ctx, toolchain_linker_gdb_index(wk, ctx->compiler));
+		}
 	}
 
 	push_linker_args(wk, ctx, toolchain_linker_always(wk, ctx->compiler));
@@ -830,13 +872,30 @@ regenerate_build_command(struct workspace *wk, bool opts_only)
 
 		obj_array_push(wk, regen_args, make_str(wk, "-c"));
 		obj_array_push(wk, regen_args, make_str(wk, compiler_check_cache_path.buf));
+
+		// skip setup if no regenerate dep has actually changed
+		obj_array_push(wk, regen_args, make_str(wk, "-r"));
 	}
 
 	obj_dict_foreach(wk, wk->global_opts, &regen_args, add_global_opts_set_from_env_iter);
 
 	uint32_t i;
 	for (i = 0; i < wk->original_commandline.argc; ++i) {
-		obj_array_push(wk, regen_args, make_str(wk, wk->original_commandline.argv[i]));
+		const char *arg = wk->original_commandline.argv[i];
+
+		// When setup was run by the regenerate command, drop the flags
+		// added above so they don't accumulate.  A time report is only
+		// wanted for the setup it was requested on, not every
+		// regeneration after it, and subproject workers aren't used
+		// when regenerating.
+		if (strcmp(arg, "-c") == 0 || strcmp(arg, "-t") == 0 || strcmp(arg, "-j") == 0) {
+			++i;
+			continue;
+		} else if (strcmp(arg, "-r") == 0 || strncmp(arg, "-t", 2) == 0 || strncmp(arg, "-j", 2) == 0) {
+			continue;
+		}
+
+		obj_array_push(wk, regen_args, make_str(wk, arg));
 	}
 
 	return regen_args;
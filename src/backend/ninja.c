@@ -17,6 +17,7 @@
 #include "backend/output.h"
 #include "error.h"
 #include "external/samurai.h"
+#include "find_cmd_cache.h"
 #include "lang/serial.h"
 #include "log.h"
 #include "options.h"
@@ -24,10 +25,17 @@
 #include "platform/mem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "regenerate_deps.h"
+#include "setup_cache.h"
+#include "sha_256.h"
 #include "tracy.h"
 
 struct check_tgt_ctx {
+	const struct project *proj;
+	obj dwp_cmd;
 	bool need_phony;
+	bool need_lto_pool;
+	bool looked_for_dwp;
 };
 
 static enum iteration_result
@@ -45,9 +53,30 @@ check_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
 		}
 		break;
 	}
-	case obj_alias_target:
-	case obj_build_target:
-	case obj_both_libs: break;
+	case obj_both_libs: tgt_id = get_obj_both_libs(wk, tgt_id)->dynamic_lib;
+	/* fallthrough */
+	case obj_build_target: {
+		struct obj_build_target *tgt = get_obj_build_target(wk, tgt_id);
+
+		if (ninja_tgt_lto_pool(wk, ctx->proj, tgt)) {
+			ctx->need_lto_pool = true;
+		}
+
+		if (ninja_tgt_dwp(wk, ctx->proj, tgt)) {
+			if (!ctx->looked_for_dwp) {
+				ctx->looked_for_dwp = true;
+				if (!ninja_find_dwp(wk, &ctx->dwp_cmd)) {
+					ctx->dwp_cmd = 0;
+				}
+			}
+
+			if (ctx->dwp_cmd && !ninja_tgt_add_dwp(wk, tgt)) {
+				return ir_err;
+			}
+		}
+		break;
+	}
+	case obj_alias_target: break;
 	default: UNREACHABLE;
 	}
 
@@ -99,8 +128,94 @@ write_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
 	return ret;
 }
 
+/*
+ * The targets of each project are written to their own file in the private
+ * dir, which build.ninja pulls in with subninja.  A file is only replaced when
+ * its contents change, which saves rewriting the files of unchanged projects.
+ * Neither ninja nor samu caches subninja files, and build.ninja is touched
+ * whenever one of them changes, so the build tool still parses every project
+ * after a setup.  Subninja files have their own scope, so argument sets are
+ * interned per project.  Files left behind by projects that no longer exist
+ * are removed.
+ */
+struct write_subninja_ctx {
+	struct project *proj;
+	struct sbuf *compdb;
+	obj dwp_cmd;
+	bool thin_archives;
+	bool wrote_default;
+};
+
+static bool
+ninja_write_subninja(struct workspace *wk, void *_ctx, FILE *out)
+{
+	struct write_subninja_ctx *ctx = _ctx;
+
+	struct hash argsets;
+	hash_init(&argsets, 64, SHA_256_HASH_SIZE);
+
+	struct write_tgt_ctx tgt_ctx = {
+		.out = out,
+		.proj = ctx->proj,
+		.compdb = ctx->compdb,
+		.argsets = &argsets,
+		.rsp_threshold = ninja_rsp_threshold(wk),
+		.dwp_cmd = ctx->dwp_cmd,
+		.thin_archives = ctx->thin_archives,
+	};
+
+	fprintf(out,
+		"# This is the build file for project \"%s\"\n"
+		"# It is autogenerated by the muon build system.\n\n",
+		get_cstr(wk, ctx->proj->cfg.name));
+
+	bool ret = obj_array_foreach(wk, ctx->proj->targets, &tgt_ctx, write_tgt_iter);
+	if (!ret) {
+		LOG_E("failed to write rules for project %s", get_cstr(wk, ctx->proj->cfg.name));
+	}
+
+	ctx->wrote_default = tgt_ctx.wrote_default;
+	hash_destroy(&argsets);
+	return ret;
+}
+
+struct remove_stale_subninja_ctx {
+	struct workspace *wk;
+	const char *dir;
+};
+
+static enum iteration_result
+remove_stale_subninja_iter(void *_ctx, const char *name)
+{
+	struct remove_stale_subninja_ctx *ctx = _ctx;
+	struct workspace *wk = ctx->wk;
+
+	uint32_t i;
+	for (i = 0; i < wk->projects.len; ++i) {
+		struct project *proj = arr_get(&wk->projects, i);
+		if (proj->not_ok) {
+			continue;
+		}
+
+		const struct str *prefix = get_str(wk, proj->rule_prefix);
+		if (strncmp(name, prefix->s, prefix->len) == 0 && strcmp(&name[prefix->len], ".ninja") == 0) {
+			return ir_cont;
+		}
+	}
+
+	SBUF(path);
+	path_join(wk, &path, ctx->dir, name);
+	if (!fs_remove(path.buf)) {
+		return ir_err;
+	}
+
+	return ir_cont;
+}
+
 struct write_build_ctx {
 	obj compiler_rule_arr;
+	struct sbuf *compdb;
+	bool subninja_replaced;
 };
 
 static bool
@@ -119,31 +234,66 @@ ninja_write_build(struct workspace *wk, void *_ctx, FILE *out)
 			continue;
 		}
 
-		obj_array_foreach(wk, proj->targets, &check_ctx, check_tgt_iter);
+		check_ctx.proj = proj;
+		if (!obj_array_foreach(wk, proj->targets, &check_ctx, check_tgt_iter)) {
+			return false;
+		}
 	}
 
-	if (!ninja_write_rules(out, wk, arr_get(&wk->projects, 0), check_ctx.need_phony, ctx->compiler_rule_arr)) {
+	bool thin_archives = ninja_thin_archives(wk);
+
+	if (!ninja_write_rules(out,
+		    wk,
+		    arr_get(&wk->projects, 0),
+		    check_ctx.need_phony,
+		    check_ctx.need_lto_pool,
+		    thin_archives,
+		    ctx->compiler_rule_arr)) {
 		return false;
 	}
 
 	bool wrote_default = false;
 
+	SBUF(subninja_dir);
+	path_join(wk, &subninja_dir, wk->muon_private, output_path.subninja);
+	if (!fs_mkdir_p(subninja_dir.buf)) {
+		return false;
+	}
+
 	for (i = 0; i < wk->projects.len; ++i) {
 		struct project *proj = arr_get(&wk->projects, i);
 		if (proj->not_ok) {
 			continue;
 		}
 
-		struct write_tgt_ctx ctx = { .out = out, .proj = proj };
-
-		if (!obj_array_foreach(wk, proj->targets, &ctx, write_tgt_iter)) {
-			LOG_E("failed to write rules for project %s", get_cstr(wk, proj->cfg.name));
+		SBUF(name);
+		sbuf_pushf(wk, &name, "%s.ninja", get_cstr(wk, proj->rule_prefix));
+
+		struct write_subninja_ctx subninja_ctx = {
+			.proj = proj,
+			.compdb = ctx->compdb,
+			.dwp_cmd = check_ctx.dwp_cmd,
+			.thin_archives = thin_archives,
+		};
+		if (!with_open_replaced(
+			    subninja_dir.buf, name.buf, wk, &subninja_ctx, ninja_write_subninja, &ctx->subninja_replaced)) {
 			return false;
 		}
 
-		wrote_default |= ctx.wrote_default;
+		// rule prefixes only contain [A-Za-z0-9_], so the path needs
+		// no escaping
+		fprintf(out, "subninja %s/%s/%s\n", output_path.private_dir, output_path.subninja, name.buf);
+
+		wrote_default |= subninja_ctx.wrote_default;
 	}
 
+	struct remove_stale_subninja_ctx remove_ctx = { .wk = wk, .dir = subninja_dir.buf };
+	if (!fs_dir_foreach(subninja_dir.buf, &remove_ctx, remove_stale_subninja_iter)) {
+		return false;
+	}
+
+	fputc('\n', out);
+
 	if (coverage_enabled) {
 		ninja_coverage_write_targets(wk, out);
 	}
@@ -240,15 +390,49 @@ ninja_write_option_info(struct workspace *wk, void *_ctx, FILE *out)
 	return serial_dump(wk, arr, out);
 }
 
+static bool
+ninja_write_compdb(struct workspace *wk, void *_ctx, FILE *out)
+{
+	struct sbuf *compdb = _ctx;
+
+	fputc('[', out);
+	if (!fs_fwrite(compdb->buf, compdb->len, out)) {
+		return false;
+	}
+	fputs("\n]\n", out);
+	return true;
+}
+
 bool
 ninja_write_all(struct workspace *wk)
 {
-	struct write_build_ctx ctx = { 0 };
+	bool ret = false;
+	SBUF_manual(compdb);
+
+	// compile_commands.json entries are collected while writing the
+	// compile edges, rather than asking ninja for them afterwards.
+	struct write_build_ctx ctx = { .compdb = &compdb };
 	make_obj(wk, &ctx.compiler_rule_arr, obj_array);
 
 	obj_array_push(wk, wk->backend_output_stack, make_str(wk, "ninja_write_all"));
 
-	if (!(with_open(wk->build_root, "build.ninja", wk, &ctx, ninja_write_build)
+	bool build_ninja_replaced = false;
+	if (!with_open_replaced(wk->build_root, "build.ninja", wk, &ctx, ninja_write_build, &build_ninja_replaced)) {
+		goto ret;
+	}
+
+	// ninja only reloads its manifest after regenerating if build.ninja
+	// itself was updated, so it must also look updated when only one of
+	// the subninja files changed.
+	if (ctx.subninja_replaced && !build_ninja_replaced) {
+		SBUF(build_ninja);
+		path_join(wk, &build_ninja, wk->build_root, "build.ninja");
+		if (!fs_touch(build_ninja.buf)) {
+			goto ret;
+		}
+	}
+
+	if (!(with_open(wk->build_root, "compile_commands.json", wk, &compdb, ninja_write_compdb)
 		    && with_open(wk->muon_private, output_path.tests, wk, NULL, ninja_write_tests)
 		    && with_open(wk->muon_private, output_path.install, wk, NULL, ninja_write_install)
 		    && with_open(wk->muon_private,
@@ -256,31 +440,19 @@ ninja_write_all(struct workspace *wk)
 			    wk,
 			    NULL,
 			    ninja_write_compiler_check_cache)
+		    && with_open(wk->muon_private, output_path.find_cmd_cache, wk, NULL, find_cmd_cache_dump)
+		    && with_open(wk->muon_private, output_path.setup_cache, wk, NULL, setup_cache_dump)
 		    && with_open(wk->muon_private, output_path.summary, wk, NULL, ninja_write_summary_file)
-		    && with_open(wk->muon_private, output_path.option_info, wk, NULL, ninja_write_option_info))) {
-		return false;
+		    && with_open(wk->muon_private, output_path.option_info, wk, NULL, ninja_write_option_info)
+		    && with_open(wk->muon_private, output_path.regenerate_deps, wk, NULL, regenerate_deps_dump))) {
+		goto ret;
 	}
 
 	obj_array_pop(wk, wk->backend_output_stack);
-
-	{ /* compile_commands.json */
-		TracyCZoneN(tctx_compdb, "output compile_commands.json", true);
-
-		obj compdb_args;
-		make_obj(wk, &compdb_args, obj_array);
-		obj_array_push(wk, compdb_args, make_str(wk, "-C"));
-		obj_array_push(wk, compdb_args, make_str(wk, wk->build_root));
-		obj_array_push(wk, compdb_args, make_str(wk, "-t"));
-		obj_array_push(wk, compdb_args, make_str(wk, "compdb"));
-		obj_array_extend_nodup(wk, compdb_args, ctx.compiler_rule_arr);
-		if (!ninja_run(wk, compdb_args, wk->build_root, "compile_commands.json")) {
-			LOG_E("error writing compile_commands.json");
-		}
-
-		TracyCZoneEnd(tctx_compdb);
-	}
-
-	return true;
+	ret = true;
+ret:
+	sbuf_destroy(&compdb);
+	return ret;
 }
 
 bool
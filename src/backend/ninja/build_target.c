@@ -5,18 +5,26 @@
 
 #include "compat.h"
 
+#include <inttypes.h>
 #include <string.h>
 
 #include "args.h"
 #include "backend/common_args.h"
 #include "backend/ninja.h"
 #include "backend/ninja/build_target.h"
+#include "backend/ninja/rules.h"
+#include "backend/pch.h"
+#include "backend/unity.h"
 #include "error.h"
 #include "functions/build_target.h"
+#include "install.h"
+#include "lang/object_iterators.h"
 #include "lang/workspace.h"
 #include "log.h"
+#include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
+#include "sha_256.h"
 
 struct write_tgt_iter_ctx {
 	FILE *out;
@@ -27,6 +35,12 @@ struct write_tgt_iter_ctx {
 	obj object_names;
 	obj order_deps;
 	obj implicit_deps;
+	obj unity_srcs;
+	obj pch; // dict[lang -> [output, use args]]
+	struct sbuf *compdb;
+	struct hash *argsets; // sha_256(joined args) -> argset index
+	uint32_t rsp_threshold;
+	bool thin_archives;
 	bool have_order_deps;
 	bool have_link_language;
 };
@@ -43,12 +57,120 @@ add_tgt_objects_iter(struct workspace *wk, void *_ctx, obj val)
 	return ir_cont;
 }
 
+static void
+compdb_push_args(struct workspace *wk, struct sbuf *cmd, const struct args *args)
+{
+	uint32_t i;
+	for (i = 0; i < args->len; ++i) {
+		sbuf_push(wk, cmd, ' ');
+		sbuf_pushs(wk, cmd, args->args[i]);
+	}
+}
+
+/*
+ * Append a compile_commands.json entry for a compile edge.  The command is
+ * put together the same way as the compiler rule's.  args are already joined
+ * for ninja and are unescaped along the way, while input and output are
+ * shell escaped like ninja does for $in and $out.
+ */
+static void
+compdb_push_entry(struct workspace *wk,
+	struct write_tgt_iter_ctx *ctx,
+	enum compiler_language lang,
+	const char *args,
+	const char *input,
+	const char *output)
+{
+	obj comp_id;
+	if (!obj_dict_geti(wk, ctx->proj->compilers, lang, &comp_id)) {
+		return;
+	}
+	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
+
+	SBUF(cmd);
+	sbuf_pushs(wk, &cmd, get_cstr(wk, join_args_plain(wk, comp->cmd_arr)));
+
+	sbuf_push(wk, &cmd, ' ');
+	for (; *args; ++args) {
+		if (*args == '$' && args[1]) {
+			++args;
+		}
+		sbuf_push(wk, &cmd, *args);
+	}
+
+	SBUF(esc_input);
+	SBUF(esc_output);
+	shell_escape(wk, &esc_input, input);
+	shell_escape(wk, &esc_output, output);
+
+	if (toolchain_compiler_deps_type(wk, comp)->len) {
+		SBUF(depfile);
+		SBUF(esc_depfile);
+		sbuf_pushf(wk, &depfile, "%s.d", output);
+		shell_escape(wk, &esc_depfile, depfile.buf);
+		compdb_push_args(wk, &cmd, toolchain_compiler_deps(wk, comp, esc_output.buf, esc_depfile.buf));
+	}
+
+	compdb_push_args(wk, &cmd, toolchain_compiler_debugfile(wk, comp, esc_output.buf));
+	compdb_push_args(wk, &cmd, toolchain_compiler_output(wk, comp, esc_output.buf));
+	compdb_push_args(wk, &cmd, toolchain_compiler_compile_only(wk, comp));
+	sbuf_push(wk, &cmd, ' ');
+	sbuf_pushs(wk, &cmd, esc_input.buf);
+
+	struct sbuf *compdb = ctx->compdb;
+	sbuf_pushs(wk, compdb, compdb->len ? ",\n  {\n" : "\n  {\n");
+	sbuf_pushs(wk, compdb, "    \"directory\": \"");
+	sbuf_push_json_escaped(wk, compdb, wk->build_root, strlen(wk->build_root));
+	sbuf_pushs(wk, compdb, "\",\n    \"command\": \"");
+	sbuf_push_json_escaped(wk, compdb, cmd.buf, cmd.len);
+	sbuf_pushs(wk, compdb, "\",\n    \"file\": \"");
+	sbuf_push_json_escaped(wk, compdb, input, strlen(input));
+	sbuf_pushs(wk, compdb, "\",\n    \"output\": \"");
+	sbuf_push_json_escaped(wk, compdb, output, strlen(output));
+	sbuf_pushs(wk, compdb, "\"\n  }");
+}
+
+/*
+ * Many targets end up with exactly the same compiler arguments, so argument
+ * sets are interned by their hash and only written once, as top-level
+ * variables that compile edges refer to.  Returns the argument set's index.
+ */
+static uint64_t
+intern_argset(struct workspace *wk, struct write_tgt_iter_ctx *ctx, obj args)
+{
+	const struct str *s = get_str(wk, args);
+
+	uint8_t hash[SHA_256_HASH_SIZE];
+	calc_sha_256(hash, s->s, s->len);
+
+	uint64_t *v;
+	if ((v = hash_get(ctx->argsets, hash))) {
+		return *v;
+	}
+
+	uint64_t argset = ctx->argsets->len;
+	hash_set(ctx->argsets, hash, argset);
+	fprintf(ctx->out, "argset_%" PRIu64 " = %s\n", argset, s->s);
+	return argset;
+}
+
+static const char *
+rsp_rule_suffix(const struct write_tgt_iter_ctx *ctx, uint64_t args_len)
+{
+	return ctx->rsp_threshold && args_len > ctx->rsp_threshold ? NINJA_RSP_RULE_SUFFIX : "";
+}
+
 static enum iteration_result
 write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 {
 	struct write_tgt_iter_ctx *ctx = _ctx;
 	const char *src = get_file_path(wk, val);
 
+	if (ctx->unity_srcs && obj_dict_in(wk, ctx->unity_srcs, *get_obj_file(wk, val))) {
+		// compiled as part of a unity file
+		return ir_cont;
+	}
+
 	enum compiler_language lang;
 	if (!filename_to_compiler_language(src, &lang)) {
 		UNREACHABLE;
@@ -67,7 +189,7 @@ write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 
 	/* build rules and args */
 
-	obj rule_name, specialized_rule;
+	obj rule_name;
 	{
 		obj rule_name_arr;
 		if (!obj_dict_geti(wk, ctx->tgt->required_compilers, lang, &rule_name_arr)) {
@@ -75,42 +197,282 @@ write_tgt_sources_iter(struct workspace *wk, void *_ctx, obj val)
 		}
 
 		obj_array_index(wk, rule_name_arr, 0, &rule_name);
-		obj_array_index(wk, rule_name_arr, 1, &specialized_rule);
+	}
 
-		if (!specialized_rule) {
-			if (!ctx->joined_args && !build_target_args(wk, ctx->proj, ctx->tgt, &ctx->joined_args)) {
-				return ir_err;
-			}
+	if (!ctx->joined_args && !build_target_args(wk, ctx->proj, ctx->tgt, &ctx->joined_args)) {
+		return ir_err;
+	}
+
+	obj pch_output = 0, pch_args = 0;
+	{
+		obj pch;
+		if (ctx->pch && obj_dict_geti(wk, ctx->pch, lang, &pch)) {
+			obj_array_index(wk, pch, 0, &pch_output);
+			obj_array_index(wk, pch, 1, &pch_args);
 		}
 	}
 
+	obj args;
+	if (!obj_dict_geti(wk, ctx->joined_args, lang, &args)) {
+		LOG_E("No compiler defined for language %s", compiler_language_to_s(lang));
+		return ir_err;
+	}
+
+	if (pch_args) {
+		args = make_strf(wk, "%s %s", get_cstr(wk, args), get_cstr(wk, pch_args));
+	}
+
+	uint64_t argset = intern_argset(wk, ctx, args);
+
 	SBUF(esc_dest_path);
 	SBUF(esc_path);
+	SBUF(esc_dwo_path);
 
 	ninja_escape(wk, &esc_dest_path, dest_path.buf);
 	ninja_escape(wk, &esc_path, src_path.buf);
 
-	fprintf(ctx->out, "build %s: %s %s", esc_dest_path.buf, get_cstr(wk, rule_name), esc_path.buf);
+	{
+		obj comp_id;
+		if (obj_dict_geti(wk, ctx->proj->compilers, lang, &comp_id)
+			&& build_target_split_dwarf(wk, get_obj_compiler(wk, comp_id), ctx->proj, ctx->tgt)) {
+			// the .dwo is written next to the object, with its
+			// extension replaced
+			SBUF(dwo_path);
+			path_without_ext(wk, &dwo_path, dest_path.buf);
+			sbuf_pushs(wk, &dwo_path, ".dwo");
+			ninja_escape(wk, &esc_dwo_path, dwo_path.buf);
+		}
+	}
+
+	fprintf(ctx->out,
+		"build %s%s%s: %s%s %s",
+		esc_dest_path.buf,
+		esc_dwo_path.len ? " | " : "",
+		esc_dwo_path.buf,
+		get_cstr(wk, rule_name),
+		rsp_rule_suffix(ctx, get_str(wk, args)->len),
+		esc_path.buf);
 	if (ctx->implicit_deps) {
 		fputs(" | ", ctx->out);
 		fputs(get_cstr(wk, ctx->implicit_deps), ctx->out);
 	}
-	if (ctx->have_order_deps) {
-		fprintf(ctx->out, " || %s", get_cstr(wk, ctx->order_deps));
+	if (ctx->have_order_deps || pch_output) {
+		fputs(" ||", ctx->out);
+		if (ctx->have_order_deps) {
+			fprintf(ctx->out, " %s", get_cstr(wk, ctx->order_deps));
+		}
+		if (pch_output) {
+			fprintf(ctx->out, " %s", get_cstr(wk, pch_output));
+		}
+	}
+	fprintf(ctx->out, "\n ARGS = $argset_%" PRIu64 "\n", argset);
+
+	if (ctx->compdb) {
+		compdb_push_entry(wk, ctx, lang, get_cstr(wk, args), src_path.buf, dest_path.buf);
 	}
-	fputc('\n', ctx->out);
 
-	if (!specialized_rule) {
+	return ir_cont;
+}
+
+static bool
+write_tgt_pch(struct workspace *wk, struct write_tgt_iter_ctx *ctx)
+{
+	obj k, header;
+	obj_dict_for(wk, ctx->tgt->pch, k, header) {
+		enum compiler_language lang = k;
+		struct pch pch;
+		if (!pch_get(wk, ctx->proj, ctx->tgt, lang, &pch)) {
+			continue;
+		}
+
+		obj rule_name_arr, pch_rule;
+		if (!obj_dict_geti(wk, ctx->tgt->required_compilers, lang, &rule_name_arr)) {
+			UNREACHABLE;
+		}
+		obj_array_index(wk, rule_name_arr, 1, &pch_rule);
+
+		if (!ctx->joined_args && !build_target_args(wk, ctx->proj, ctx->tgt, &ctx->joined_args)) {
+			return false;
+		}
+
 		obj args;
 		if (!obj_dict_geti(wk, ctx->joined_args, lang, &args)) {
 			LOG_E("No compiler defined for language %s", compiler_language_to_s(lang));
-			return ir_err;
+			return false;
+		}
+
+		SBUF(esc_output);
+		ninja_escape(wk, &esc_output, get_cstr(wk, pch.output));
+
+		SBUF(input);
+		SBUF(esc_input);
+		if (pch.msvc) {
+			if (!pch_write_src(wk, &pch)) {
+				return false;
+			}
+
+			path_relative_to(wk, &input, wk->build_root, get_file_path(wk, pch.src));
+			obj_array_push(wk, ctx->object_names, pch.object);
+
+			SBUF(esc_object);
+			ninja_escape(wk, &esc_object, get_cstr(wk, pch.object));
+			fprintf(ctx->out, "build %s | %s: ", esc_object.buf, esc_output.buf);
+		} else {
+			path_relative_to(wk, &input, wk->build_root, get_cstr(wk, pch.header));
+			fprintf(ctx->out, "build %s: ", esc_output.buf);
+		}
+
+		obj create_args
+			= make_strf(wk, "%s %s", get_cstr(wk, args), get_cstr(wk, pch_create_args(wk, ctx->proj, &pch, lang)));
+
+		ninja_escape(wk, &esc_input, input.buf);
+		fprintf(ctx->out,
+			"%s%s %s",
+			get_cstr(wk, pch_rule),
+			rsp_rule_suffix(ctx, get_str(wk, create_args)->len),
+			esc_input.buf);
+		if (ctx->implicit_deps) {
+			fputs(" | ", ctx->out);
+			fputs(get_cstr(wk, ctx->implicit_deps), ctx->out);
 		}
+		if (ctx->have_order_deps) {
+			fprintf(ctx->out, " || %s", get_cstr(wk, ctx->order_deps));
+		}
+		fprintf(ctx->out, "\n ARGS = %s\n", get_cstr(wk, create_args));
+
+		if (ctx->compdb) {
+			compdb_push_entry(wk,
+				ctx,
+				lang,
+				get_cstr(wk, create_args),
+				input.buf,
+				pch.msvc ? get_cstr(wk, pch.object) : get_cstr(wk, pch.output));
+		}
+
+		obj arr;
+		make_obj(wk, &arr, obj_array);
+		obj_array_push(wk, arr, make_str(wk, esc_output.buf));
+		obj_array_push(wk, arr, pch_use_args(wk, ctx->proj, &pch, lang));
 
-		fprintf(ctx->out, " ARGS = %s\n", get_cstr(wk, args));
+		if (!ctx->pch) {
+			make_obj(wk, &ctx->pch, obj_dict);
+		}
+		obj_dict_seti(wk, ctx->pch, lang, arr);
 	}
 
-	return ir_cont;
+	return true;
+}
+
+/*
+ * With b_split_dwarf_dwp, the .dwo files of installed executables and shared
+ * libraries, which are left in the build dir, are packaged into a .dwp that
+ * is installed next to them.  Whether split DWARF applies depends on the
+ * compiler of the target's link language, which is only settled once all of
+ * its dependencies are known, so this is decided by the backend.
+ */
+bool
+ninja_tgt_dwp(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt)
+{
+#ifdef MUON_BOOTSTRAPPED
+	if (!tgt->install_target || (tgt->type & tgt_static_library)) {
+		return false;
+	}
+
+	obj dwp;
+	get_option_value_overridable(wk, proj, tgt->override_options, "b_split_dwarf_dwp", &dwp);
+	if (!get_obj_bool(wk, dwp)) {
+		return false;
+	}
+
+	obj comp_id;
+	return obj_dict_geti(wk, proj->compilers, tgt->dep_internal.link_language, &comp_id)
+	       && build_target_split_dwarf(wk, get_obj_compiler(wk, comp_id), proj, tgt);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Unless env.DWP is set, only llvm-dwp is used, since the binutils dwp
+ * crashes on the DWARF 5 units that current compilers emit by default.
+ */
+bool
+ninja_find_dwp(struct workspace *wk, obj *res)
+{
+	obj opt_id;
+	if (!get_option(wk, NULL, &WKSTR("env.DWP"), &opt_id)) {
+		UNREACHABLE;
+	}
+	const struct obj_option *opt = get_obj_option(wk, opt_id);
+
+	if (opt->source > option_value_source_default) {
+		*res = opt->val;
+		return true;
+	}
+
+	SBUF(path);
+	if (!fs_find_cmd(wk, &path, "llvm-dwp")) {
+		LOG_W("b_split_dwarf_dwp: llvm-dwp not found, no .dwp files will be created (set DWP to use another dwp)");
+		return false;
+	}
+
+	make_obj(wk, res, obj_array);
+	obj_array_push(wk, *res, sbuf_into_str(wk, &path));
+	return true;
+}
+
+bool
+ninja_tgt_add_dwp(struct workspace *wk, struct obj_build_target *tgt)
+{
+	tgt->flags |= build_tgt_flag_dwp;
+
+	// The .dwp gets the destination and mode of the target's own install
+	// entry.
+	const struct obj_install_target *in = get_obj_install_target(wk, tgt->install_target);
+
+	struct obj_install_target *dwp;
+	if (!(dwp = push_install_target(wk,
+		      make_strf(wk, "%s.dwp", get_cstr(wk, in->src)),
+		      make_strf(wk, "%s.dwp", get_cstr(wk, in->dest)),
+		      0))) {
+		return false;
+	}
+
+	dwp->has_perm = in->has_perm;
+	dwp->perm = in->perm;
+	return true;
+}
+
+/*
+ * dwp finds the .dwo files of every object that went into the target,
+ * including those from static libraries, through the target itself.
+ */
+static void
+write_tgt_dwp(struct workspace *wk, struct write_tgt_ctx *wctx, const struct obj_build_target *tgt, const char *path)
+{
+	obj cmd;
+	obj_array_dup(wk, wctx->dwp_cmd, &cmd);
+	obj_array_push(wk, cmd, make_str(wk, "-e"));
+	obj_array_push(wk, cmd, make_str(wk, path));
+	obj_array_push(wk, cmd, make_str(wk, "-o"));
+	obj_array_push(wk, cmd, make_strf(wk, "%s.dwp", path));
+
+	SBUF(esc_path);
+	ninja_escape(wk, &esc_path, path);
+
+	fprintf(wctx->out,
+		"build %s.dwp: CUSTOM_COMMAND %s\n"
+		" COMMAND = %s\n"
+		" DESC = packaging split debug info for %s\n",
+		esc_path.buf,
+		esc_path.buf,
+		get_cstr(wk, join_args_shell_ninja(wk, cmd)),
+		esc_path.buf);
+
+	if (tgt->flags & build_tgt_flag_build_by_default) {
+		fprintf(wctx->out, "default %s.dwp\n", esc_path.buf);
+	}
+	fprintf(wctx->out, "\n");
 }
 
 bool
@@ -130,6 +492,10 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 		.tgt = tgt,
 		.proj = wctx->proj,
 		.out = wctx->out,
+		.compdb = wctx->compdb,
+		.argsets = wctx->argsets,
+		.rsp_threshold = wctx->rsp_threshold,
+		.thin_archives = wctx->thin_archives,
 	};
 
 	struct obj_compiler *compiler;
@@ -175,6 +541,25 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 	{ /* sources */
 		obj_array_foreach(wk, tgt->objects, &ctx, add_tgt_objects_iter);
 
+		if (tgt->pch && !write_tgt_pch(wk, &ctx)) {
+			return false;
+		}
+
+		obj batches = 0;
+		if (unity_batches(wk, tgt, &batches, &ctx.unity_srcs)) {
+			if (!unity_write_batches(wk, batches)) {
+				return false;
+			}
+
+			obj batch, unity_file;
+			obj_array_for(wk, batches, batch) {
+				obj_array_index(wk, batch, 0, &unity_file);
+				if (write_tgt_sources_iter(wk, &ctx, unity_file) == ir_err) {
+					return false;
+				}
+			}
+		}
+
 		if (!obj_array_foreach(wk, tgt->src, &ctx, write_tgt_sources_iter)) {
 			return false;
 		}
@@ -220,15 +605,25 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 		linker_type = compiler_language_to_s(tgt->dep_internal.link_language);
 		link_args = get_cstr(wk, join_args_shell_ninja(wk, ctx.args.link_args));
 		break;
-	case tgt_static_library:
-		linker_type = "static";
+	case tgt_static_library: {
+		bool thin = ctx.thin_archives && !(tgt->flags & build_tgt_flag_installed);
+		linker_type = thin ? "static" NINJA_THIN_RULE_SUFFIX : "static";
 		link_args = 0;
 		break;
+	}
 	default: assert(false); return false;
 	}
 
-	fprintf(wctx->out, "build %s: %s_%s_linker ", esc_path.buf, get_cstr(wk, ctx.proj->rule_prefix), linker_type);
-	fputs(get_cstr(wk, join_args_ninja(wk, ctx.object_names)), wctx->out);
+	obj objects = join_args_ninja(wk, ctx.object_names);
+	uint64_t link_len = get_str(wk, objects)->len + (link_args ? strlen(link_args) : 0);
+
+	fprintf(wctx->out,
+		"build %s: %s_%s_linker%s ",
+		esc_path.buf,
+		get_cstr(wk, ctx.proj->rule_prefix),
+		linker_type,
+		rsp_rule_suffix(&ctx, link_len));
+	fputs(get_cstr(wk, objects), wctx->out);
 	if (get_obj_array(wk, implicit_link_deps)->len) {
 		implicit_link_deps = join_args_ninja(wk, implicit_link_deps);
 		fputs(" | ", wctx->out);
@@ -241,11 +636,18 @@ ninja_write_build_tgt(struct workspace *wk, obj tgt_id, struct write_tgt_ctx *wc
 	if (link_args) {
 		fprintf(wctx->out, "\n LINK_ARGS = %s", link_args);
 	}
+	if (ninja_tgt_lto_pool(wk, ctx.proj, tgt)) {
+		fputs("\n pool = " NINJA_LTO_POOL, wctx->out);
+	}
 
 	if (tgt->flags & build_tgt_flag_build_by_default) {
 		wctx->wrote_default = true;
 		fprintf(wctx->out, "\ndefault %s\n", esc_path.buf);
 	}
 	fprintf(wctx->out, "\n");
+
+	if (tgt->flags & build_tgt_flag_dwp) {
+		write_tgt_dwp(wk, wctx, tgt, rel_build_path.buf);
+	}
 	return true;
 }
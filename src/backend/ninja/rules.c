@@ -11,19 +11,21 @@
 #include "backend/common_args.h"
 #include "backend/ninja/rules.h"
 #include "backend/output.h"
+#include "backend/pch.h"
 #include "error.h"
 #include "functions/machine.h"
 #include "lang/workspace.h"
 #include "log.h"
 #include "options.h"
+#include "platform/os.h"
 #include "platform/path.h"
 #include "tracy.h"
 
 struct write_compiler_rule_ctx {
 	FILE *out;
 	struct project *proj;
-	struct obj_build_target *tgt;
-	obj args, generic_rules;
+	obj generic_rules, pch_rules;
+	bool rsp;
 };
 
 static void
@@ -53,28 +55,55 @@ escape_rule(struct sbuf *buf)
 	}
 }
 
-static enum iteration_result
-write_linker_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+static void
+write_rsp(FILE *out, const char *content)
+{
+	fprintf(out,
+		" rspfile = $out.rsp\n"
+		" rspfile_content = %s\n",
+		content);
+}
+
+static void
+write_linker_rule(struct workspace *wk,
+	struct write_compiler_rule_ctx *ctx,
+	enum compiler_language l,
+	obj comp_id,
+	bool rsp_rule)
 {
-	enum compiler_language l = k;
-	struct write_compiler_rule_ctx *ctx = _ctx;
 	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
 
 	obj args;
 	make_obj(wk, &args, obj_array);
 
+	bool rsp;
+	const struct args *rsp_args;
 	if (comp->linker_passthrough) {
+		rsp_args = toolchain_compiler_rsp(wk, comp, "$out.rsp");
+		rsp = rsp_rule && rsp_args->len;
+
 		obj_array_extend(wk, args, comp->cmd_arr);
 		obj_array_push(wk, args, make_str(wk, "$ARGS"));
 
 		push_args(wk, args, toolchain_compiler_output(wk, comp, "$out"));
-		obj_array_push(wk, args, make_str(wk, "$in"));
-		obj_array_push(wk, args, make_str(wk, "$LINK_ARGS"));
+		if (rsp) {
+			push_args(wk, args, rsp_args);
+		} else {
+			obj_array_push(wk, args, make_str(wk, "$in"));
+			obj_array_push(wk, args, make_str(wk, "$LINK_ARGS"));
+		}
 	} else {
+		rsp_args = toolchain_linker_rsp(wk, comp, "$out.rsp");
+		rsp = rsp_rule && rsp_args->len;
+
 		obj_array_extend(wk, args, comp->linker_cmd_arr);
 		obj_array_push(wk, args, make_str(wk, "$ARGS"));
-		push_args(wk, args, toolchain_linker_input_output(wk, comp, "$in", "$out"));
-		obj_array_push(wk, args, make_str(wk, "$LINK_ARGS"));
+		if (rsp) {
+			push_args(wk, args, toolchain_linker_input_output(wk, comp, rsp_args->args[0], "$out"));
+		} else {
+			push_args(wk, args, toolchain_linker_input_output(wk, comp, "$in", "$out"));
+			obj_array_push(wk, args, make_str(wk, "$LINK_ARGS"));
+		}
 	}
 
 	obj link_command = join_args_plain(wk, args);
@@ -87,23 +116,43 @@ write_linker_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
 	const char *linker_pool = "";
 #endif
 
-
 	fprintf(ctx->out,
-		"rule %s_%s_linker\n"
+		"rule %s_%s_linker%s\n"
 		" command = %s\n"
 		" description = linking $out\n"
-		"%s"
-		"\n",
+		"%s",
 		get_cstr(wk, ctx->proj->rule_prefix),
 		compiler_language_to_s(l),
+		rsp_rule ? NINJA_RSP_RULE_SUFFIX : "",
 		get_cstr(wk, link_command),
 		linker_pool);
+	if (rsp) {
+		write_rsp(ctx->out, "$in $LINK_ARGS");
+	}
+	fputc('\n', ctx->out);
+}
+
+static enum iteration_result
+write_linker_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+{
+	struct write_compiler_rule_ctx *ctx = _ctx;
+
+	write_linker_rule(wk, ctx, k, comp_id, false);
+	if (ctx->rsp) {
+		write_linker_rule(wk, ctx, k, comp_id, true);
+	}
 
 	return ir_cont;
 }
 
 static void
-write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_name, enum compiler_language l, obj comp_id)
+write_compiler_rule(struct workspace *wk,
+	FILE *out,
+	obj rule_name,
+	enum compiler_language l,
+	obj comp_id,
+	bool pch,
+	bool rsp_rule)
 {
 	struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
 
@@ -115,10 +164,17 @@ write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_nam
 		}
 	}
 
+	const struct args *rsp_args = toolchain_compiler_rsp(wk, comp, "$out.rsp");
+	bool rsp = rsp_rule && rsp_args->len;
+
 	obj args;
 	make_obj(wk, &args, obj_array);
 	obj_array_extend(wk, args, comp->cmd_arr);
-	obj_array_push(wk, args, rule_args);
+	if (rsp) {
+		push_args(wk, args, rsp_args);
+	} else {
+		obj_array_push(wk, args, make_str(wk, "$ARGS"));
+	}
 
 	if (deps) {
 		push_args(wk, args, toolchain_compiler_deps(wk, comp, "$out", "${out}.d"));
@@ -133,9 +189,10 @@ write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_nam
 	obj compile_command = join_args_plain(wk, args);
 
 	fprintf(out,
-		"rule %s\n"
+		"rule %s%s\n"
 		" command = %s\n",
 		get_cstr(wk, rule_name),
+		rsp_rule ? NINJA_RSP_RULE_SUFFIX : "",
 		get_cstr(wk, compile_command));
 	if (deps) {
 		fprintf(out,
@@ -143,81 +200,45 @@ write_compiler_rule(struct workspace *wk, FILE *out, obj rule_args, obj rule_nam
 			" depfile = ${out}.d\n",
 			deps);
 	}
-	fprintf(out, " description = compiling %s $out\n\n", compiler_language_to_s(l));
+	if (rsp) {
+		write_rsp(out, "$ARGS");
+	}
+	fprintf(out, " description = %s %s $out\n\n", pch ? "precompiling" : "compiling", compiler_language_to_s(l));
 }
 
 static enum iteration_result
-write_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+write_generic_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
 {
 	enum compiler_language l = k;
 	struct write_compiler_rule_ctx *ctx = _ctx;
-
 	obj rule_name;
-	{
-		obj rule_name_arr;
-		if (!obj_dict_geti(wk, ctx->tgt->required_compilers, l, &rule_name_arr)) {
-			return ir_cont;
-		}
-
-		obj specialized_rule;
-		obj_array_index(wk, rule_name_arr, 0, &rule_name);
-		obj_array_index(wk, rule_name_arr, 1, &specialized_rule);
-
-		if (!specialized_rule) {
-			return ir_cont;
-		}
-	}
-
-	obj rule_args;
-	if (!obj_dict_geti(wk, ctx->args, l, &rule_args)) {
-		UNREACHABLE;
-	}
-
-	write_compiler_rule(wk, ctx->out, rule_args, rule_name, l, comp_id);
-	return ir_cont;
-}
-
-static enum iteration_result
-write_compiler_rule_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
-{
-	struct write_compiler_rule_ctx *ctx = _ctx;
-	enum iteration_result ret = ir_err;
 
-	if (get_obj_type(wk, tgt_id) != obj_build_target) {
+	if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
 		return ir_cont;
 	}
 
-	struct obj_clear_mark mk;
-	obj_set_clear_mark(wk, &mk);
-
-	ctx->tgt = get_obj_build_target(wk, tgt_id);
-
-	if (!build_target_args(wk, ctx->proj, ctx->tgt, &ctx->args)) {
-		goto ret;
-	}
-
-	if (!obj_dict_foreach(wk, ctx->proj->compilers, ctx, write_compiler_rule_iter)) {
-		goto ret;
+	write_compiler_rule(wk, ctx->out, rule_name, l, comp_id, false, false);
+	if (ctx->rsp) {
+		write_compiler_rule(wk, ctx->out, rule_name, l, comp_id, false, true);
 	}
-
-	ret = ir_cont;
-ret:
-	obj_clear(wk, &mk);
-	return ret;
+	return ir_cont;
 }
 
 static enum iteration_result
-write_generic_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
+write_pch_rule_iter(struct workspace *wk, void *_ctx, obj k, obj comp_id)
 {
 	enum compiler_language l = k;
 	struct write_compiler_rule_ctx *ctx = _ctx;
 	obj rule_name;
 
-	if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
+	if (!obj_dict_geti(wk, ctx->pch_rules, l, &rule_name)) {
 		return ir_cont;
 	}
 
-	write_compiler_rule(wk, ctx->out, make_str(wk, "$ARGS"), rule_name, l, comp_id);
+	write_compiler_rule(wk, ctx->out, rule_name, l, comp_id, true, false);
+	if (ctx->rsp) {
+		write_compiler_rule(wk, ctx->out, rule_name, l, comp_id, true, true);
+	}
 	return ir_cont;
 }
 
@@ -227,47 +248,48 @@ struct name_compiler_rule_ctx {
 	obj rule_prefix_arr;
 	obj compiler_rule_arr;
 	obj generic_rules;
+	obj pch_rules;
 };
 
 static enum iteration_result
-name_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, uint32_t count)
+name_compiler_rule_iter(struct workspace *wk, void *_ctx, obj k, uint32_t _count)
 {
 	enum compiler_language l = k;
 	struct name_compiler_rule_ctx *ctx = _ctx;
-	bool specialized_rule = count > 2;
 
+	// All compile edges of a project share one rule per language, their
+	// arguments are passed in through interned argument sets.
 	obj rule_name;
-	SBUF(rule_name_buf);
-	if (specialized_rule) {
+	if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
+		SBUF(rule_name_buf);
 		sbuf_pushf(wk,
 			&rule_name_buf,
-			"%s_%s_compiler_for_%s",
+			"%s_%s_compiler",
 			get_cstr(wk, ctx->proj->rule_prefix),
-			compiler_language_to_s(l),
-			get_cstr(wk, ctx->tgt->build_name));
+			compiler_language_to_s(l));
 
 		escape_rule(&rule_name_buf);
 		obj name = sbuf_into_str(wk, &rule_name_buf);
 		uniqify_name(wk, ctx->compiler_rule_arr, name, &rule_name);
-	} else {
-		if (!obj_dict_geti(wk, ctx->generic_rules, l, &rule_name)) {
-			sbuf_pushf(wk,
-				&rule_name_buf,
-				"%s_%s_compiler",
-				get_cstr(wk, ctx->proj->rule_prefix),
-				compiler_language_to_s(l));
-
-			escape_rule(&rule_name_buf);
-			obj name = sbuf_into_str(wk, &rule_name_buf);
-			uniqify_name(wk, ctx->compiler_rule_arr, name, &rule_name);
-			obj_dict_seti(wk, ctx->generic_rules, l, rule_name);
-		}
+		obj_dict_seti(wk, ctx->generic_rules, l, rule_name);
+	}
+
+	obj pch_rule = 0;
+	struct pch pch;
+	if (pch_get(wk, ctx->proj, ctx->tgt, l, &pch) && !obj_dict_geti(wk, ctx->pch_rules, l, &pch_rule)) {
+		SBUF(pch_rule_buf);
+		sbuf_pushf(wk, &pch_rule_buf, "%s_%s_pch", get_cstr(wk, ctx->proj->rule_prefix), compiler_language_to_s(l));
+
+		escape_rule(&pch_rule_buf);
+		obj name = sbuf_into_str(wk, &pch_rule_buf);
+		uniqify_name(wk, ctx->compiler_rule_arr, name, &pch_rule);
+		obj_dict_seti(wk, ctx->pch_rules, l, pch_rule);
 	}
 
 	obj arr;
 	make_obj(wk, &arr, obj_array);
 	obj_array_push(wk, arr, rule_name);
-	obj_array_push(wk, arr, specialized_rule);
+	obj_array_push(wk, arr, pch_rule);
 
 	obj_dict_seti(wk, ctx->tgt->required_compilers, l, arr);
 	return ir_cont;
@@ -291,13 +313,140 @@ name_compiler_rule_tgt_iter(struct workspace *wk, void *_ctx, obj tgt_id)
 	return ir_cont;
 }
 
+static void
+write_static_linker_rule(struct workspace *wk,
+	FILE *out,
+	const struct project *proj,
+	struct obj_compiler *comp,
+	bool thin,
+	bool rsp_rule)
+{
+	const struct args *rsp_args = toolchain_static_linker_rsp(wk, comp, "$out.rsp");
+	bool rsp = rsp_rule && rsp_args->len;
+
+	const struct args *base = toolchain_static_linker_base(wk, comp);
+	if (thin && toolchain_static_linker_base_thin(wk, comp)->len) {
+		base = toolchain_static_linker_base_thin(wk, comp);
+	}
+
+	obj static_link_args;
+	make_obj(wk, &static_link_args, obj_array);
+
+	// TODO: make this overrideable
+	const enum static_linker_type type = comp->type[toolchain_component_static_linker];
+	if (type == static_linker_ar_posix || type == static_linker_ar_gcc) {
+		obj_array_push(wk, static_link_args, make_str(wk, wk->argv0));
+		obj_array_push(wk, static_link_args, make_str(wk, "internal"));
+		obj_array_push(wk, static_link_args, make_str(wk, "exe"));
+		obj_array_push(wk, static_link_args, make_str(wk, "-R"));
+		obj_array_push(wk, static_link_args, make_str(wk, "$out"));
+		obj_array_push(wk, static_link_args, make_str(wk, "--"));
+	}
+
+	obj_array_extend(wk, static_link_args, comp->static_linker_cmd_arr);
+	push_args(wk, static_link_args, toolchain_static_linker_always(wk, comp));
+	push_args(wk, static_link_args, base);
+	push_args(wk,
+		static_link_args,
+		toolchain_static_linker_input_output(wk, comp, rsp ? rsp_args->args[0] : "$in", "$out"));
+
+	fprintf(out,
+		"rule %s_static%s_linker%s\n"
+		" command = %s\n"
+		" description = linking static $out\n",
+		get_cstr(wk, proj->rule_prefix),
+		thin ? NINJA_THIN_RULE_SUFFIX : "",
+		rsp_rule ? NINJA_RSP_RULE_SUFFIX : "",
+		get_cstr(wk, join_args_plain(wk, static_link_args)));
+	if (rsp) {
+		write_rsp(out, "$in");
+	}
+	fputc('\n', out);
+}
+
+/*
+ * Edges whose arguments are longer than backend_rsp_threshold use the
+ * response file variant of their rule.  0 means response files are never
+ * used.
+ */
+uint32_t
+ninja_rsp_threshold(struct workspace *wk)
+{
+#ifdef MUON_BOOTSTRAPPED
+	obj threshold;
+	get_option_value(wk, arr_get(&wk->projects, 0), "backend_rsp_threshold", &threshold);
+	return get_obj_number(wk, threshold);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * With backend_thin_archives, static libraries that aren't installed are
+ * created as thin archives, which only reference their objects instead of
+ * copying them.  Installed libraries must stay self-contained.
+ */
 bool
-ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bool need_phony, obj compiler_rule_arr)
+ninja_thin_archives(struct workspace *wk)
+{
+#ifdef MUON_BOOTSTRAPPED
+	obj thin_archives;
+	get_option_value(wk, arr_get(&wk->projects, 0), "backend_thin_archives", &thin_archives);
+	return get_obj_bool(wk, thin_archives);
+#else
+	return false;
+#endif
+}
+
+#ifdef MUON_BOOTSTRAPPED
+static uint32_t
+ninja_lto_threads(struct workspace *wk)
+{
+	obj lto_threads;
+	get_option_value(wk, arr_get(&wk->projects, 0), "b_lto_threads", &lto_threads);
+	return get_obj_number(wk, lto_threads);
+}
+#endif
+
+/*
+ * Most of the code generation of an LTO build happens at link time, and each
+ * LTO link may itself run b_lto_threads jobs.  When b_lto_threads is set,
+ * these links are put in their own pool so that running several of them at
+ * once next to compiles doesn't oversubscribe the machine.  Otherwise they
+ * stay in linker_pool like any other link.
+ */
+bool
+ninja_tgt_lto_pool(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt)
+{
+#ifdef MUON_BOOTSTRAPPED
+	if (tgt->type & tgt_static_library) {
+		return false;
+	} else if (!ninja_lto_threads(wk)) {
+		return false;
+	}
+
+	obj lto;
+	get_option_value_overridable(wk, proj, tgt->override_options, "b_lto", &lto);
+	return get_obj_bool(wk, lto);
+#else
+	return false;
+#endif
+}
+
+bool
+ninja_write_rules(FILE *out,
+	struct workspace *wk,
+	struct project *main_proj,
+	bool need_phony,
+	bool need_lto_pool,
+	bool thin_archives,
+	obj compiler_rule_arr)
 {
 	TracyCZoneAutoS;
 	obj_array_push(wk, wk->backend_output_stack, make_str(wk, "ninja_write_rules"));
 
 	bool res = false;
+	uint32_t rsp_threshold = ninja_rsp_threshold(wk);
 
 	fprintf(out,
 		"# This is the build file for project \"%s\"\n"
@@ -317,6 +466,26 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 			" depth = %lld\n\n",
 			(long long int)linker_pool_depth);
 	}
+
+	if (need_lto_pool) {
+		uint32_t jobs = os_parallel_job_count(), threads = ninja_lto_threads(wk);
+
+		// The depth comes from the job count of the machine running
+		// setup and is fixed in build.ninja until the next setup.  LTO
+		// links don't go through linker_pool, so they are limited by
+		// backend_max_links here instead.
+		uint32_t lto_pool_depth = jobs > threads ? jobs / threads : 1;
+		if (linker_pool_depth && linker_pool_depth < lto_pool_depth) {
+			lto_pool_depth = linker_pool_depth;
+		}
+
+		fprintf(out,
+			"pool " NINJA_LTO_POOL "\n"
+			" depth = %u\n\n",
+			lto_pool_depth);
+	}
+#else
+	(void)need_lto_pool;
 #endif
 
 	obj regen_cmd = join_args_shell(wk, regenerate_build_command(wk, false));
@@ -326,8 +495,10 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 		" command = %s",
 		get_cstr(wk, regen_cmd));
 
+	// build.ninja is only replaced if its contents change
 	fputs("\n description = Regenerating build files.\n"
 	      " generator = 1\n"
+	      " restat = 1\n"
 	      "\n",
 		out);
 
@@ -379,8 +550,9 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 			uniqify_name(wk, rule_prefix_arr, sbuf_into_str(wk, &pre), &proj->rule_prefix);
 		}
 
-		obj generic_rules;
+		obj generic_rules, pch_rules;
 		make_obj(wk, &generic_rules, obj_dict);
+		make_obj(wk, &pch_rules, obj_dict);
 
 		{
 			struct name_compiler_rule_ctx ctx = {
@@ -388,6 +560,7 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 				.rule_prefix_arr = rule_prefix_arr,
 				.compiler_rule_arr = compiler_rule_arr,
 				.generic_rules = generic_rules,
+				.pch_rules = pch_rules,
 			};
 
 			if (!obj_array_foreach(wk, proj->targets, &ctx, name_compiler_rule_tgt_iter)) {
@@ -404,16 +577,18 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 				.out = out,
 				.proj = proj,
 				.generic_rules = generic_rules,
+				.pch_rules = pch_rules,
+				.rsp = rsp_threshold > 0,
 			};
 
 			struct obj_clear_mark mk;
 			obj_set_clear_mark(wk, &mk);
 
-			if (!obj_array_foreach(wk, proj->targets, &ctx, write_compiler_rule_tgt_iter)) {
+			if (!obj_dict_foreach(wk, proj->compilers, &ctx, write_generic_compiler_rule_iter)) {
 				goto ret;
 			}
 
-			if (!obj_dict_foreach(wk, proj->compilers, &ctx, write_generic_compiler_rule_iter)) {
+			if (!obj_dict_foreach(wk, proj->compilers, &ctx, write_pch_rule_iter)) {
 				goto ret;
 			}
 
@@ -446,34 +621,13 @@ ninja_write_rules(FILE *out, struct workspace *wk, struct project *main_proj, bo
 			if (comp_id) {
 				struct obj_compiler *comp = get_obj_compiler(wk, comp_id);
 
-				obj static_link_args;
-				make_obj(wk, &static_link_args, obj_array);
-
-				// TODO: make this overrideable
-				const enum static_linker_type type = comp->type[toolchain_component_static_linker];
-				if (type == static_linker_ar_posix || type == static_linker_ar_gcc) {
-					obj_array_push(wk, static_link_args, make_str(wk, wk->argv0));
-					obj_array_push(wk, static_link_args, make_str(wk, "internal"));
-					obj_array_push(wk, static_link_args, make_str(wk, "exe"));
-					obj_array_push(wk, static_link_args, make_str(wk, "-R"));
-					obj_array_push(wk, static_link_args, make_str(wk, "$out"));
-					obj_array_push(wk, static_link_args, make_str(wk, "--"));
+				uint32_t thin;
+				for (thin = 0; thin < (thin_archives ? 2 : 1); ++thin) {
+					uint32_t rsp_rule;
+					for (rsp_rule = 0; rsp_rule < (rsp_threshold ? 2 : 1); ++rsp_rule) {
+						write_static_linker_rule(wk, out, proj, comp, thin, rsp_rule);
+					}
 				}
-
-				obj_array_extend(wk, static_link_args, comp->static_linker_cmd_arr);
-				push_args(wk, static_link_args, toolchain_static_linker_always(wk, comp));
-				push_args(wk, static_link_args, toolchain_static_linker_base(wk, comp));
-				push_args(wk,
-					static_link_args,
-					toolchain_static_linker_input_output(wk, comp, "$in", "$out"));
-
-				fprintf(out,
-					"rule %s_static_linker\n"
-					" command = %s\n"
-					" description = linking static $out\n"
-					"\n",
-					get_cstr(wk, proj->rule_prefix),
-					get_cstr(wk, join_args_plain(wk, static_link_args)));
 			}
 		}
 	}
@@ -8,6 +8,7 @@
 #include <string.h>
 
 #include "backend/output.h"
+#include "fs_cache.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
 #include "tracy.h"
@@ -19,6 +20,12 @@ const struct output_path output_path = {
 	.install = "install.dat",
 	.compiler_check_cache = "compiler_check_cache.dat",
 	.option_info = "option_info.dat",
+	.find_cmd_cache = "find_cmd_cache.dat",
+	.setup_cache = "setup_cache.dat",
+	.time_report = "time_report.json",
+	.regenerate_deps = "regenerate_deps.dat",
+	.subproject_workers = "subproject_workers",
+	.subninja = "subninja",
 };
 
 FILE *
@@ -32,8 +39,20 @@ output_open(const char *dir, const char *name)
 	return f;
 }
 
+/*
+ * Outputs are written to a temporary file next to the destination first, and
+ * only moved into place if their contents changed.  This keeps the mtimes of
+ * unchanged outputs intact, so that regenerating doesn't cause needless work
+ * for the build tool or anything else watching the build directory.  If
+ * replaced is not NULL, it is set to true when the destination was replaced.
+ */
 bool
-with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb)
+with_open_replaced(const char *dir,
+	const char *name,
+	struct workspace *wk,
+	void *ctx,
+	with_open_callback cb,
+	bool *replaced)
 {
 	TracyCZone(tctx_func, true);
 #ifdef TRACY_ENABLE
@@ -44,16 +63,35 @@ with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, wi
 
 	obj_array_push(wk, wk->backend_output_stack, make_strf(wk, "writing %s", name));
 
+	SBUF(path);
+	path_join(wk, &path, dir, name);
+
+	SBUF(tmp_path);
+	sbuf_pushf(wk, &tmp_path, "%s.tmp", path.buf);
+
 	bool ret = false;
 	FILE *out;
-	if (!(out = output_open(dir, name))) {
+	if (!(out = fs_fopen(tmp_path.buf, "wb"))) {
 		goto ret;
 	} else if (!cb(wk, ctx, out)) {
+		fs_fclose(out);
+		fs_remove(tmp_path.buf);
 		goto ret;
 	} else if (!fs_fclose(out)) {
+		fs_remove(tmp_path.buf);
 		goto ret;
 	}
 
+	if (fs_files_equal(tmp_path.buf, path.buf)) {
+		if (!fs_remove(tmp_path.buf)) {
+			goto ret;
+		}
+	} else if (!fs_rename(tmp_path.buf, path.buf)) {
+		goto ret;
+	} else if (replaced) {
+		*replaced = true;
+	}
+
 	ret = true;
 ret:
 	obj_array_pop(wk, wk->backend_output_stack);
@@ -61,3 +99,40 @@ ret:
 	TracyCZoneEnd(tctx_func);
 	return ret;
 }
+
+bool
+with_open(const char *dir, const char *name, struct workspace *wk, void *ctx, with_open_callback cb)
+{
+	return with_open_replaced(dir, name, wk, ctx, cb, NULL);
+}
+
+static bool
+output_write_sbuf(struct workspace *wk, void *_ctx, FILE *out)
+{
+	const struct sbuf *contents = _ctx;
+	return fs_fwrite(contents->buf, contents->len, out);
+}
+
+/*
+ * Writes contents to path, creating its parent dirs, unless it already
+ * contains exactly that.  The file is replaced through with_open_replaced, so
+ * it is never seen half written.
+ */
+bool
+output_write_if_changed(struct workspace *wk, const char *path, const struct sbuf *contents)
+{
+	if (fs_file_has_content(path, (uint8_t *)contents->buf, contents->len)) {
+		return true;
+	}
+
+	SBUF(dir);
+	SBUF(name);
+	path_dirname(wk, &dir, path);
+	path_basename(wk, &name, path);
+	if (!fs_mkdir_p(dir.buf)) {
+		return false;
+	}
+
+	fs_cache_forget(wk, path);
+	return with_open_replaced(dir.buf, name.buf, wk, (void *)contents, output_write_sbuf, NULL);
+}
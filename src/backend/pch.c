@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "args.h"
+#include "backend/output.h"
+#include "backend/pch.h"
+#include "functions/build_target.h"
+#include "options.h"
+#include "platform/path.h"
+
+/*
+ * Precompiled headers set with the <lang>_pch build target kwargs are
+ * compiled by a separate edge into <private_path>/pch_<lang>/, which every
+ * source of that language has as an order-only dependency.  Rebuilds when the
+ * header changes are handled by the depfiles.
+ *
+ * How the header is precompiled depends on the compiler's pch_type: gcc-like
+ * compilers compile the header directly, while msvc-like compilers compile a
+ * source that includes it, producing an additional object.  The source may be
+ * passed along with the header, otherwise one is generated.
+ */
+
+static struct obj_compiler *
+pch_compiler(struct workspace *wk, const struct project *proj, enum compiler_language lang)
+{
+	obj comp_id;
+	if (!obj_dict_geti(wk, proj->compilers, lang, &comp_id)) {
+		return 0;
+	}
+
+	return get_obj_compiler(wk, comp_id);
+}
+
+bool
+pch_get(struct workspace *wk,
+	const struct project *proj,
+	const struct obj_build_target *tgt,
+	enum compiler_language lang,
+	struct pch *res)
+{
+	obj files, header, _;
+	if (!tgt->pch || !obj_dict_geti(wk, tgt->pch, lang, &files)
+		|| !obj_dict_geti(wk, tgt->required_compilers, lang, &_)) {
+		return false;
+	}
+
+	obj b_pch;
+	get_option_value_overridable(wk, proj, tgt->override_options, "b_pch", &b_pch);
+	if (!get_obj_bool(wk, b_pch)) {
+		return false;
+	}
+
+	struct obj_compiler *comp;
+	if (!(comp = pch_compiler(wk, proj, lang))) {
+		return false;
+	}
+
+	const struct args *pch_type = toolchain_compiler_pch_type(wk, comp);
+	if (!pch_type->len) {
+		return false;
+	}
+
+	obj_array_index(wk, files, 0, &header);
+
+	*res = (struct pch){
+		.header = *get_obj_file(wk, header),
+		.msvc = strcmp(pch_type->args[0], "msvc") == 0,
+	};
+
+	SBUF(name);
+	path_basename(wk, &name, get_cstr(wk, res->header));
+	sbuf_pushs(wk, &name, res->msvc ? ".pch" : ".gch");
+
+	SBUF(dir);
+	path_join(wk, &dir, get_cstr(wk, tgt->private_path), "pch_");
+	sbuf_pushs(wk, &dir, compiler_language_to_s(lang));
+
+	SBUF(path);
+	path_join(wk, &path, dir.buf, name.buf);
+
+	SBUF(rel);
+	path_relative_to(wk, &rel, wk->build_root, path.buf);
+	res->output = sbuf_into_str(wk, &rel);
+
+	if (res->msvc) {
+		if (get_obj_array(wk, files)->len > 1) {
+			obj_array_index(wk, files, 1, &res->src);
+		} else {
+			SBUF(src_name);
+			path_basename(wk, &src_name, get_cstr(wk, res->header));
+			sbuf_pushf(wk, &src_name, ".%s", compiler_language_extension(lang));
+
+			SBUF(src_path);
+			path_join(wk, &src_path, dir.buf, src_name.buf);
+
+			make_obj(wk, &res->src, obj_file);
+			*get_obj_file(wk, res->src) = sbuf_into_str(wk, &src_path);
+			res->generated_src = true;
+		}
+
+		SBUF(object);
+		if (!tgt_src_to_object_path(wk, tgt, res->src, true, &object)) {
+			return false;
+		}
+		res->object = sbuf_into_str(wk, &object);
+	}
+
+	return true;
+}
+
+obj
+pch_use_args(struct workspace *wk, const struct project *proj, const struct pch *pch, enum compiler_language lang)
+{
+	obj args;
+	make_obj(wk, &args, obj_array);
+	push_args(wk,
+		args,
+		toolchain_compiler_pch_use(
+			wk, pch_compiler(wk, proj, lang), get_cstr(wk, pch->header), get_cstr(wk, pch->output)));
+	return join_args_shell_ninja(wk, args);
+}
+
+obj
+pch_create_args(struct workspace *wk, const struct project *proj, const struct pch *pch, enum compiler_language lang)
+{
+	obj args;
+	make_obj(wk, &args, obj_array);
+	push_args(wk,
+		args,
+		toolchain_compiler_pch_create(
+			wk, pch_compiler(wk, proj, lang), get_cstr(wk, pch->header), get_cstr(wk, pch->output)));
+	return join_args_shell_ninja(wk, args);
+}
+
+/*
+ * Writes the source used to create an msvc precompiled header if none was
+ * given and it has changed.
+ */
+bool
+pch_write_src(struct workspace *wk, const struct pch *pch)
+{
+	if (!pch->generated_src) {
+		return true;
+	}
+
+	SBUF(contents);
+	sbuf_pushf(wk, &contents, "#include \"%s\"\n", get_cstr(wk, pch->header));
+
+	return output_write_if_changed(wk, get_file_path(wk, pch->src), &contents);
+}
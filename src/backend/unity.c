@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include "backend/output.h"
+#include "backend/unity.h"
+#include "lang/object_iterators.h"
+#include "options.h"
+#include "platform/path.h"
+
+/*
+ * With the unity option, the c, cpp, objc, and objcpp sources of a target are
+ * compiled in batches of unity_size through generated
+ * <private_path>/<name>-unity<N>.<ext> files that #include every source in
+ * the batch.  Generated sources are still compiled on their own, since they
+ * may not exist yet when the unity files are compiled.
+ *
+ * The batches only depend on the target and its options, so the backend and
+ * extract_all_objects() agree on the resulting object files.
+ */
+
+/*
+ * tgt may be NULL to check the project's setting, as for meson.is_unity().
+ */
+bool
+unity_enabled(struct workspace *wk, const struct project *proj, const struct obj_build_target *tgt)
+{
+#ifndef MUON_BOOTSTRAPPED
+	// The unity options aren't defined until muon is bootstrapped
+	return false;
+#endif
+
+	obj opt;
+	get_option_value_overridable(wk, proj, tgt ? tgt->override_options : 0, "unity", &opt);
+
+	const struct str *s = get_str(wk, opt);
+	if (str_eql(s, &WKSTR("on"))) {
+		return true;
+	} else if (str_eql(s, &WKSTR("subprojects"))) {
+		return !!proj->subproject_name;
+	}
+
+	return false;
+}
+
+static const char *
+unity_language_ext(enum compiler_language lang)
+{
+	switch (lang) {
+	case compiler_language_c: return "c";
+	case compiler_language_cpp: return "cpp";
+	case compiler_language_objc: return "m";
+	case compiler_language_objcpp: return "mm";
+	default: return 0;
+	}
+}
+
+/*
+ * If unity builds are enabled for tgt, sets batches to a list of
+ * [unity file, list[file]] and unity_srcs to a dict of every source that is
+ * part of a batch, and returns true.
+ */
+bool
+unity_batches(struct workspace *wk, const struct obj_build_target *tgt, obj *batches, obj *unity_srcs)
+{
+	// The decision is made with the options of the project that defined
+	// tgt, which isn't necessarily the current one.
+	const struct project *proj = arr_get(&wk->projects, tgt->project_id);
+	if (!unity_enabled(wk, proj, tgt)) {
+		return false;
+	}
+
+	obj unity_size;
+	get_option_value_overridable(wk, proj, tgt->override_options, "unity_size", &unity_size);
+
+	// The batch currently being filled, and the number of batches so far,
+	// for each language
+	obj cur[compiler_language_count] = { 0 };
+	uint32_t count[compiler_language_count] = { 0 };
+
+	make_obj(wk, batches, obj_array);
+	make_obj(wk, unity_srcs, obj_dict);
+
+	obj src;
+	obj_array_for(wk, tgt->src, src) {
+		const char *path = get_file_path(wk, src);
+
+		enum compiler_language lang;
+		const char *ext;
+		if (!filename_to_compiler_language(path, &lang) || !(ext = unity_language_ext(lang))
+			|| path_is_subpath(wk->build_root, path)) {
+			continue;
+		}
+
+		if (!cur[lang] || get_obj_array(wk, cur[lang])->len >= get_obj_number(wk, unity_size)) {
+			SBUF(name);
+			sbuf_pushf(wk, &name, "%s-unity%d.%s", get_cstr(wk, tgt->name), count[lang], ext);
+
+			SBUF(unity_path);
+			path_join(wk, &unity_path, get_cstr(wk, tgt->private_path), name.buf);
+
+			obj unity_file, batch;
+			make_obj(wk, &unity_file, obj_file);
+			*get_obj_file(wk, unity_file) = sbuf_into_str(wk, &unity_path);
+
+			make_obj(wk, &cur[lang], obj_array);
+			make_obj(wk, &batch, obj_array);
+			obj_array_push(wk, batch, unity_file);
+			obj_array_push(wk, batch, cur[lang]);
+			obj_array_push(wk, *batches, batch);
+			++count[lang];
+		}
+
+		obj_array_push(wk, cur[lang], src);
+		obj_dict_set(wk, *unity_srcs, *get_obj_file(wk, src), src);
+	}
+
+	return true;
+}
+
+/*
+ * Unity files are only written when their contents change so that
+ * regenerating the build doesn't cause everything to be rebuilt.
+ */
+bool
+unity_write_batches(struct workspace *wk, obj batches)
+{
+	obj batch;
+	obj_array_for(wk, batches, batch) {
+		obj unity_file, srcs, src;
+		obj_array_index(wk, batch, 0, &unity_file);
+		obj_array_index(wk, batch, 1, &srcs);
+
+		SBUF(contents);
+		obj_array_for(wk, srcs, src) {
+			sbuf_pushf(wk, &contents, "#include \"%s\"\n", get_file_path(wk, src));
+		}
+
+		if (!output_write_if_changed(wk, get_file_path(wk, unity_file), &contents)) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "coerce.h"
+#include "fs_cache.h"
 #include "functions/environment.h"
 #include "lang/object_iterators.h"
 #include "lang/typecheck.h"
@@ -374,7 +375,7 @@ coerce_requirement(struct workspace *wk, struct args_kw *kw_required, enum requi
 	return true;
 }
 
-typedef bool (*exists_func)(const char *);
+typedef bool (*exists_func)(struct workspace *wk, const char *);
 
 enum coerce_into_files_mode {
 	mode_input,
@@ -433,7 +434,7 @@ coerce_into_file(struct workspace *wk, struct coerce_into_files_ctx *ctx, obj va
 				return ir_err;
 			}
 
-			if (!ctx->exists(get_file_path(wk, *file))) {
+			if (!ctx->exists(wk, get_file_path(wk, *file))) {
 				vm_error_at(wk, ctx->node, "%s %o does not exist", ctx->type, val);
 				return ir_err;
 			}
@@ -563,7 +564,7 @@ coerce_output_files(struct workspace *wk, uint32_t node, obj val, const char *ou
 bool
 coerce_files(struct workspace *wk, uint32_t node, obj val, obj *res)
 {
-	return _coerce_files(wk, node, val, res, "file", fs_file_exists, mode_input, 0);
+	return _coerce_files(wk, node, val, res, "file", fs_cache_file_exists, mode_input, 0);
 }
 
 bool
@@ -573,7 +574,7 @@ coerce_file(struct workspace *wk, uint32_t node, obj val, obj *res)
 		.node = node,
 		.arr = *res,
 		.type = "file",
-		.exists = fs_file_exists,
+		.exists = fs_cache_file_exists,
 		.mode = mode_input,
 	};
 
@@ -583,7 +584,7 @@ coerce_file(struct workspace *wk, uint32_t node, obj val, obj *res)
 bool
 coerce_dirs(struct workspace *wk, uint32_t node, obj val, obj *res)
 {
-	return _coerce_files(wk, node, val, res, "directory", fs_dir_exists, mode_input, 0);
+	return _coerce_files(wk, node, val, res, "directory", fs_cache_dir_exists, mode_input, 0);
 }
 
 struct include_directories_iter_ctx {
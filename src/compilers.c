@@ -473,6 +473,22 @@ static_linker_detect(struct workspace *wk, obj comp, enum compiler_language lang
 	return true;
 }
 
+/*
+ * Links go through the compiler driver, which may run bfd, gold, or lld
+ * depending on how it was configured.  Only gold and lld understand
+ * --gdb-index, so ask the driver which one it runs.
+ */
+static void
+linker_detect_gdb_index(struct workspace *wk, struct obj_compiler *comp)
+{
+	struct run_cmd_ctx cmd_ctx = { 0 };
+	if (run_cmd_arr(wk, &cmd_ctx, comp->cmd_arr, "-Wl,--version") && cmd_ctx.status == 0) {
+		comp->linker_gdb_index = strstr(cmd_ctx.out.buf, "GNU gold") || strstr(cmd_ctx.out.buf, "LLD ");
+	}
+
+	run_cmd_ctx_destroy(&cmd_ctx);
+}
+
 static bool
 linker_detect(struct workspace *wk, obj comp, enum compiler_language lang, obj cmd_arr)
 {
@@ -498,6 +514,10 @@ linker_detect(struct workspace *wk, obj comp, enum compiler_language lang, obj c
 
 	run_cmd_ctx_destroy(&cmd_ctx);
 
+	if (type == linker_ld || type == linker_clang) {
+		linker_detect_gdb_index(wk, get_obj_compiler(wk, comp));
+	}
+
 	get_obj_compiler(wk, comp)->linker_cmd_arr = cmd_arr;
 	get_obj_compiler(wk, comp)->type[toolchain_component_linker] = type;
 	return true;
@@ -706,6 +726,18 @@ TOOLCHAIN_PROTO_ns(toolchain_arg_empty_ns)
 	return a;
 }
 
+/* shared by all toolchains that read arguments from @<file> */
+
+TOOLCHAIN_PROTO_1s(toolchain_args_rsp)
+{
+	static char buf[BUF_SIZE_1k];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_1k, "@%s", a);
+
+	return &args;
+}
+
 /* posix compilers */
 
 TOOLCHAIN_PROTO_0(compiler_posix_args_object_extension)
@@ -1072,6 +1104,13 @@ TOOLCHAIN_PROTO_0(compiler_gcc_args_lto)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(compiler_gcc_args_split_dwarf)
+{
+	TOOLCHAIN_ARGS({ "-gsplit-dwarf" });
+
+	return &args;
+}
+
 TOOLCHAIN_PROTO_0(compiler_gcc_args_coverage)
 {
 	TOOLCHAIN_ARGS({ "--coverage" })
@@ -1079,6 +1118,49 @@ TOOLCHAIN_PROTO_0(compiler_gcc_args_coverage)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_2s(compiler_gcc_args_pch_create)
+{
+	TOOLCHAIN_ARGS({ "-x", NULL });
+
+	switch (comp->lang) {
+	case compiler_language_cpp: argv[1] = "c++-header"; break;
+	case compiler_language_objc: argv[1] = "objective-c-header"; break;
+	case compiler_language_objcpp: argv[1] = "objective-c++-header"; break;
+	default: argv[1] = "c-header"; break;
+	}
+
+	return &args;
+}
+
+/*
+ * gcc checks for <file>.gch before reading <file> for -include <file>, so the
+ * precompiled header is included by its path minus the extension.
+ * -fpch-deps makes the depfile list the headers that went into it.
+ */
+TOOLCHAIN_PROTO_2s(compiler_gcc_args_pch_use)
+{
+	static char buf[BUF_SIZE_1k];
+	TOOLCHAIN_ARGS({ "-fpch-deps", "-include", buf });
+
+	snprintf(buf, BUF_SIZE_1k, "%s", b);
+
+	char *ext;
+	if ((ext = strrchr(buf, '.')) && strcmp(ext, ".gch") == 0) {
+		*ext = 0;
+	}
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_clang_args_pch_use)
+{
+	TOOLCHAIN_ARGS({ "-include-pch", NULL });
+
+	argv[1] = b;
+
+	return &args;
+}
+
 /* cl compilers
  * see mesonbuild/compilers/mixins/visualstudio.py for reference
  */
@@ -1257,6 +1339,29 @@ TOOLCHAIN_PROTO_1s(compiler_cl_args_define)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_2s(compiler_cl_args_pch_create)
+{
+	static char yc[BUF_SIZE_1k], fp[BUF_SIZE_1k];
+	TOOLCHAIN_ARGS({ yc, fp });
+
+	snprintf(yc, BUF_SIZE_1k, "/Yc%s", a);
+	snprintf(fp, BUF_SIZE_1k, "/Fp%s", b);
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_2s(compiler_cl_args_pch_use)
+{
+	static char yu[BUF_SIZE_1k], fp[BUF_SIZE_1k], fi[BUF_SIZE_1k];
+	TOOLCHAIN_ARGS({ yu, fp, fi });
+
+	snprintf(yu, BUF_SIZE_1k, "/Yu%s", a);
+	snprintf(fp, BUF_SIZE_1k, "/Fp%s", b);
+	snprintf(fi, BUF_SIZE_1k, "/FI%s", a);
+
+	return &args;
+}
+
 TOOLCHAIN_PROTO_0(compiler_cl_args_object_extension)
 {
 	TOOLCHAIN_ARGS({ ".obj" });
@@ -1315,6 +1420,26 @@ TOOLCHAIN_PROTO_0(compiler_deps_msvc)
 	return &args;
 }
 
+/*
+ * The pch type determines how a precompiled header is created.  With "gcc" the
+ * header itself is compiled into the precompiled header, with "msvc" a source
+ * including the header is compiled, producing an object that must be linked
+ * along with the precompiled header.
+ */
+TOOLCHAIN_PROTO_0(compiler_pch_gcc)
+{
+	TOOLCHAIN_ARGS({ "gcc" });
+
+	return &args;
+}
+
+TOOLCHAIN_PROTO_0(compiler_pch_msvc)
+{
+	TOOLCHAIN_ARGS({ "msvc" });
+
+	return &args;
+}
+
 TOOLCHAIN_PROTO_1s(linker_posix_args_lib)
 {
 	TOOLCHAIN_ARGS({ "-l", NULL });
@@ -1408,6 +1533,38 @@ TOOLCHAIN_PROTO_1s(linker_ld_args_whole_archive)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(linker_ld_args_gdb_index)
+{
+	if (!comp->linker_gdb_index) {
+		return toolchain_arg_empty_0(wk, comp);
+	}
+
+	TOOLCHAIN_ARGS({ "--gdb-index" });
+	return &args;
+}
+
+TOOLCHAIN_PROTO_1i(linker_ld_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "-flto=%d", a);
+
+	return &args;
+}
+
+/* clang linkers */
+
+TOOLCHAIN_PROTO_1i(linker_clang_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "-flto-jobs=%d", a);
+
+	return &args;
+}
+
 /* cl linkers */
 
 TOOLCHAIN_PROTO_1s(linker_link_args_lib)
@@ -1459,6 +1616,16 @@ TOOLCHAIN_PROTO_1s(linker_lld_link_args_whole_archive)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_1i(linker_lld_link_args_lto_threads)
+{
+	static char buf[BUF_SIZE_S];
+	TOOLCHAIN_ARGS({ buf });
+
+	snprintf(buf, BUF_SIZE_S, "/opt:lldltojobs=%d", a);
+
+	return &args;
+}
+
 /* apple linker */
 
 TOOLCHAIN_PROTO_1s(linker_apple_args_whole_archive)
@@ -1494,6 +1661,12 @@ TOOLCHAIN_PROTO_0(static_linker_ar_gcc_args_base)
 	return &args;
 }
 
+TOOLCHAIN_PROTO_0(static_linker_ar_gcc_args_base_thin)
+{
+	TOOLCHAIN_ARGS({ "csrDT" });
+	return &args;
+}
+
 struct compiler compilers[compiler_type_count];
 struct linker linkers[linker_type_count];
 struct static_linker static_linkers[static_linker_type_count];
@@ -1555,16 +1728,24 @@ build_compilers(void)
 	gcc.args.specify_lang = compiler_gcc_args_specify_lang;
 	gcc.args.color_output = compiler_gcc_args_color_output;
 	gcc.args.enable_lto = compiler_gcc_args_lto;
+	gcc.args.split_dwarf = compiler_gcc_args_split_dwarf;
 	gcc.args.deps_type = compiler_deps_gcc;
 	gcc.args.coverage = compiler_gcc_args_coverage;
+	gcc.args.pch_type = compiler_pch_gcc;
+	gcc.args.pch_create = compiler_gcc_args_pch_create;
+	gcc.args.pch_use = compiler_gcc_args_pch_use;
+	gcc.args.rsp = toolchain_args_rsp;
 	gcc.default_linker = linker_ld;
 	gcc.default_static_linker = static_linker_ar_gcc;
 
 	struct compiler clang = gcc;
 	clang.args.warn_everything = compiler_clang_args_warn_everything;
+	clang.args.pch_use = compiler_clang_args_pch_use;
 	clang.default_linker = linker_clang;
 
 	struct compiler apple_clang = clang;
+	// Mach-O debug info is collected by dsymutil instead
+	apple_clang.args.split_dwarf = toolchain_arg_empty_0;
 	apple_clang.default_linker = linker_apple;
 	apple_clang.default_static_linker = static_linker_ar_posix;
 
@@ -1590,6 +1771,10 @@ build_compilers(void)
 	msvc.args.object_ext = compiler_cl_args_object_extension;
 	msvc.args.deps_type = compiler_deps_msvc;
 	msvc.args.std_supported = compiler_cl_args_std_supported;
+	msvc.args.pch_type = compiler_pch_msvc;
+	msvc.args.pch_create = compiler_cl_args_pch_create;
+	msvc.args.pch_use = compiler_cl_args_pch_use;
+	msvc.args.rsp = toolchain_args_rsp;
 
 	struct compiler clang_cl = msvc;
 	clang_cl.args.color_output = compiler_clang_cl_args_color_output;
@@ -1644,14 +1829,19 @@ build_linkers(void)
 	ld.args.fatal_warnings = linker_ld_args_fatal_warnings;
 	ld.args.whole_archive = linker_ld_args_whole_archive;
 	ld.args.enable_lto = compiler_gcc_args_lto;
+	ld.args.lto_threads = linker_ld_args_lto_threads;
+	ld.args.gdb_index = linker_ld_args_gdb_index;
 	ld.args.coverage = compiler_gcc_args_coverage;
+	ld.args.rsp = toolchain_args_rsp;
 
 	struct linker lld = ld;
+	lld.args.lto_threads = linker_clang_args_lto_threads;
 
 	struct linker apple = posix;
 	posix.args.shared = linker_posix_args_shared;
 	apple.args.sanitize = compiler_gcc_args_sanitize;
 	apple.args.enable_lto = compiler_gcc_args_lto;
+	apple.args.lto_threads = linker_clang_args_lto_threads;
 	apple.args.allow_shlib_undefined = linker_apple_args_allow_shlib_undefined;
 	apple.args.shared_module = linker_apple_args_shared_module;
 	apple.args.whole_archive = linker_apple_args_whole_archive;
@@ -1663,9 +1853,11 @@ build_linkers(void)
 	link.args.soname = linker_link_args_soname;
 	link.args.input_output = linker_link_args_input_output;
 	link.args.always = compiler_cl_args_always;
+	link.args.rsp = toolchain_args_rsp;
 
 	struct linker lld_link = link;
 	lld_link.args.whole_archive = linker_lld_link_args_whole_archive;
+	lld_link.args.lto_threads = linker_lld_link_args_lto_threads;
 	lld_link.args.always = toolchain_arg_empty_0;
 
 	linkers[linker_posix] = posix;
@@ -1687,10 +1879,13 @@ build_static_linkers(void)
 
 	struct static_linker gcc = posix;
 	gcc.args.base = static_linker_ar_gcc_args_base;
+	gcc.args.base_thin = static_linker_ar_gcc_args_base_thin;
+	gcc.args.rsp = toolchain_args_rsp;
 
 	struct static_linker msvc = empty;
 	msvc.args.input_output = linker_link_args_input_output;
 	msvc.args.always = compiler_cl_args_always;
+	msvc.args.rsp = toolchain_args_rsp;
 
 	static_linkers[static_linker_ar_posix] = posix;
 	static_linkers[static_linker_ar_gcc] = gcc;
@@ -18,17 +18,34 @@ struct embedded_file {
 #include "embedded_files.h"
 #else
 static struct embedded_file embedded[] = { 0 };
-static uint32_t embedded_len = 0;
+static const uint32_t embedded_buckets_len = 1;
+static const uint32_t embedded_buckets[] = { 0 };
 #endif
 
+// FNV-1a, must match embedded_hash in tools/embedder.c
+static uint32_t
+embedded_hash(const char *s)
+{
+	uint32_t h = 2166136261u;
+	for (; *s; ++s) {
+		h ^= (uint8_t)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
 const char *
 embedded_get(const char *name)
 {
-	uint32_t i;
-	for (i = 0; i < embedded_len; ++i) {
-		if (strcmp(embedded[i].name, name) == 0) {
-			return embedded[i].src;
+	const uint32_t mask = embedded_buckets_len - 1;
+	uint32_t b = embedded_hash(name) & mask, i;
+
+	while ((i = embedded_buckets[b])) {
+		if (strcmp(embedded[i - 1].name, name) == 0) {
+			return embedded[i - 1].src;
 		}
+
+		b = (b + 1) & mask;
 	}
 
 	return NULL;
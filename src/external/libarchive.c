@@ -5,6 +5,8 @@
 
 #include "compat.h"
 
+#include <errno.h>
+
 #include <archive.h>
 #include <archive_entry.h>
 
@@ -38,10 +40,30 @@ copy_data(struct archive *ar, struct archive *aw)
 	}
 }
 
+struct muon_archive_read_ctx {
+	muon_archive_read_cb read_cb;
+	void *ctx;
+};
+
+static la_ssize_t
+muon_archive_read(struct archive *a, void *_ctx, const void **buf)
+{
+	struct muon_archive_read_ctx *ctx = _ctx;
+
+	int64_t len = ctx->read_cb(ctx->ctx, buf);
+	if (len < 0) {
+		archive_set_error(a, EIO, "failed to read archive data");
+		return -1;
+	}
+
+	return len;
+}
+
 bool
-muon_archive_extract(const char *buf, size_t size, const char *dest_path)
+muon_archive_extract(muon_archive_read_cb read_cb, void *ctx, const char *dest_path)
 {
 	bool res = false;
+	struct muon_archive_read_ctx read_ctx = { .read_cb = read_cb, .ctx = ctx };
 	struct archive *a;
 	struct archive *ext;
 	struct archive_entry *entry;
@@ -61,14 +83,14 @@ muon_archive_extract(const char *buf, size_t size, const char *dest_path)
 	archive_write_disk_set_options(ext, flags);
 	archive_write_disk_set_standard_lookup(ext);
 
-	if ((r = archive_read_open_memory(a, buf, size))) {
+	SBUF_manual(path);
+
+	if ((r = archive_read_open(a, &read_ctx, NULL, muon_archive_read, NULL))) {
 		// may not work, a might not be initialized ??
 		LOG_E("error opening archive: %s\n", archive_error_string(a));
 		goto ret;
 	}
 
-	SBUF_manual(path);
-
 	while (true) {
 		if ((r = archive_read_next_header(a, &entry)) == ARCHIVE_EOF) {
 			break;
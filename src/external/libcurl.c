@@ -142,3 +142,144 @@ err1:
 err0:
 	return false;
 }
+
+/*
+ * Streaming downloads.  libcurl pushes data into a write callback while
+ * consumers like libarchive want to pull it, so the transfer is driven with
+ * the multi interface from muon_curl_stream_read until some data has been
+ * received.  Only the data received since the previous read is buffered.
+ */
+struct muon_curl_stream {
+	CURL *easy;
+	CURLM *multi;
+	struct write_data_ctx buf;
+	char errbuf[CURL_ERROR_SIZE];
+	const char *url;
+	bool done, failed;
+};
+
+static void
+muon_curl_stream_check_done(struct muon_curl_stream *stream)
+{
+	CURLMsg *msg;
+	int msgs_left;
+
+	while ((msg = curl_multi_info_read(stream->multi, &msgs_left))) {
+		if (msg->msg != CURLMSG_DONE) {
+			continue;
+		}
+
+		stream->done = true;
+
+		if (msg->data.result != CURLE_OK) {
+			stream->failed = true;
+			if (*stream->errbuf) {
+				LOG_E("curl failed to fetch '%s': %s", stream->url, stream->errbuf);
+			} else {
+				LOG_E("curl failed to fetch '%s': %s", stream->url, curl_easy_strerror(msg->data.result));
+			}
+		}
+	}
+}
+
+struct muon_curl_stream *
+muon_curl_stream_open(const char *url)
+{
+	struct muon_curl_stream *stream;
+
+	LOG_I("fetching '%s'", url);
+
+	if (!fetch_ctx.init) {
+		LOG_E("curl is not initialized");
+		return NULL;
+	}
+
+	stream = z_calloc(1, sizeof(*stream));
+	stream->url = url;
+
+	if (!(stream->easy = curl_easy_init()) || !(stream->multi = curl_multi_init())) {
+		LOG_E("failed to get curl handle");
+		goto err;
+	}
+
+	if (curl_easy_setopt(stream->easy, CURLOPT_ERRORBUFFER, stream->errbuf) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_FOLLOWLOCATION, 1L) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_FAILONERROR, 1L) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_URL, url) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_NOPROGRESS, 1L) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_WRITEFUNCTION, write_data) != CURLE_OK
+		|| curl_easy_setopt(stream->easy, CURLOPT_WRITEDATA, &stream->buf) != CURLE_OK) {
+		LOG_E("failed to configure curl handle for '%s'", url);
+		goto err;
+	}
+
+	if (curl_multi_add_handle(stream->multi, stream->easy) != CURLM_OK) {
+		LOG_E("failed to add curl handle for '%s'", url);
+		goto err;
+	}
+
+	return stream;
+err:
+	if (stream->easy) {
+		curl_easy_cleanup(stream->easy);
+	}
+	if (stream->multi) {
+		curl_multi_cleanup(stream->multi);
+	}
+	z_free(stream);
+	return NULL;
+}
+
+/*
+ * Returns the number of bytes made available in *buf, 0 once the transfer is
+ * complete, or -1 on error.  *buf is valid until the next call.
+ */
+int64_t
+muon_curl_stream_read(struct muon_curl_stream *stream, const void **buf)
+{
+	// The previous block has been consumed
+	stream->buf.len = 0;
+
+	while (!stream->buf.len && !stream->done) {
+		int running;
+		if (curl_multi_perform(stream->multi, &running) != CURLM_OK) {
+			LOG_E("curl failed to fetch '%s'", stream->url);
+			stream->done = stream->failed = true;
+			break;
+		}
+
+		muon_curl_stream_check_done(stream);
+
+		if (!running) {
+			stream->done = true;
+		} else if (!stream->buf.len && !stream->done) {
+			if (curl_multi_wait(stream->multi, NULL, 0, 1000, NULL) != CURLM_OK) {
+				LOG_E("curl failed to fetch '%s'", stream->url);
+				stream->done = stream->failed = true;
+			}
+		}
+	}
+
+	if (stream->buf.len) {
+		*buf = stream->buf.buf;
+		return stream->buf.len;
+	}
+
+	return stream->failed ? -1 : 0;
+}
+
+bool
+muon_curl_stream_close(struct muon_curl_stream *stream)
+{
+	bool ok = stream->done && !stream->failed;
+
+	curl_multi_remove_handle(stream->multi, stream->easy);
+	curl_easy_cleanup(stream->easy);
+	curl_multi_cleanup(stream->multi);
+
+	if (stream->buf.buf) {
+		z_free(stream->buf.buf);
+	}
+	z_free(stream);
+	return ok;
+}
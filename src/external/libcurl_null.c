@@ -26,3 +26,22 @@ muon_curl_fetch(const char *url, uint8_t **buf, uint64_t *len)
 	LOG_W("libcurl not enabled");
 	return false;
 }
+
+struct muon_curl_stream *
+muon_curl_stream_open(const char *url)
+{
+	LOG_W("libcurl not enabled");
+	return NULL;
+}
+
+int64_t
+muon_curl_stream_read(struct muon_curl_stream *stream, const void **buf)
+{
+	return -1;
+}
+
+bool
+muon_curl_stream_close(struct muon_curl_stream *stream)
+{
+	return false;
+}
@@ -14,11 +14,13 @@
 #include "buf_size.h"
 #include "external/libpkgconf.h"
 #include "lang/object.h"
+#include "lang/object_iterators.h"
 #include "lang/workspace.h"
 #include "log.h"
 #include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
+#include "setup_cache.h"
 
 const bool have_libpkgconf = true;
 
@@ -27,6 +29,9 @@ static struct {
 	pkgconf_cross_personality_t *personality;
 	const int maxdepth;
 	bool init;
+	// set once muon_pkgconf_define has been called, since global
+	// variables can change the result of any lookup
+	bool have_defines;
 } pkgconf_ctx = {
 	.maxdepth = 200,
 };
@@ -118,9 +123,159 @@ struct pkgconf_lookup_ctx {
 	struct pkgconf_info *info;
 	obj libdirs;
 	obj name;
+	obj files;
 	bool is_static;
 };
 
+/*
+ * Results of lookups are stored in the setup cache, keyed by everything
+ * besides the .pc files that influences them: the lookup itself, the search
+ * path, and the PKG_CONFIG_* variables libpkgconf reads from the environment.
+ * The .pc files that were consulted, the search directories, and the
+ * directories searched for libraries are recorded as the files the entry
+ * depends on.
+ */
+static obj
+muon_pkgconf_cache_key(struct workspace *wk, const char *kind, const char *name, const char *extra)
+{
+	static const char *env_vars[] = {
+		"PKG_CONFIG_PATH",
+		"PKG_CONFIG_LIBDIR",
+		"PKG_CONFIG_SYSROOT_DIR",
+		"PKG_CONFIG_TOP_BUILD_DIR",
+		"PKG_CONFIG_SYSTEM_INCLUDE_PATH",
+		"PKG_CONFIG_SYSTEM_LIBRARY_PATH",
+		"PKG_CONFIG_ALLOW_SYSTEM_CFLAGS",
+		"PKG_CONFIG_ALLOW_SYSTEM_LIBS",
+		"PKG_CONFIG_DISABLE_UNINSTALLED",
+		"PKG_CONFIG_PURE_DEPGRAPH",
+	};
+
+	obj opt;
+	get_option_value(wk, current_project(wk), "pkg_config_path", &opt);
+
+	SBUF(key);
+	sbuf_pushf(wk, &key, "pkgconf:%s\n%s\n%s\n%s\n", kind, name, extra, get_cstr(wk, opt));
+
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(env_vars); ++i) {
+		const char *v;
+		if ((v = getenv(env_vars[i]))) {
+			sbuf_pushf(wk, &key, "%s=%s\n", env_vars[i], v);
+		}
+	}
+
+	return sbuf_into_str(wk, &key);
+}
+
+static void
+muon_pkgconf_push_search_dirs(struct workspace *wk, obj files)
+{
+	pkgconf_node_t *node;
+
+	PKGCONF_FOREACH_LIST_ENTRY(pkgconf_ctx.client.dir_list.head, node)
+	{
+		const pkgconf_path_t *path = node->data;
+		obj_array_push(wk, files, make_str(wk, path->path));
+	}
+}
+
+static bool
+muon_pkgconf_pkg_exists(const char *name)
+{
+	pkgconf_pkg_t *pkg;
+	if (!(pkg = pkgconf_pkg_find(&pkgconf_ctx.client, name))) {
+		return false;
+	}
+
+	pkgconf_pkg_unref(&pkgconf_ctx.client, pkg);
+	return true;
+}
+
+static void
+collect_pc_files(pkgconf_client_t *client, pkgconf_pkg_t *pkg, void *_ctx)
+{
+	struct pkgconf_lookup_ctx *ctx = _ctx;
+
+	if (pkg->filename) {
+		obj_array_push(ctx->wk, ctx->files, make_str(ctx->wk, pkg->filename));
+	}
+}
+
+enum muon_pkgconf_cache_idx {
+	muon_pkgconf_cache_idx_version,
+	muon_pkgconf_cache_idx_includes,
+	muon_pkgconf_cache_idx_libs,
+	muon_pkgconf_cache_idx_not_found_libs,
+	muon_pkgconf_cache_idx_link_args,
+	muon_pkgconf_cache_idx_compile_args,
+};
+
+static obj
+muon_pkgconf_info_to_cache(struct workspace *wk, const struct pkgconf_info *info)
+{
+	obj val, includes, inc, arr;
+	make_obj(wk, &val, obj_array);
+
+	obj_array_push(wk, val, make_str(wk, info->version));
+
+	make_obj(wk, &includes, obj_array);
+	obj_array_for(wk, info->includes, inc) {
+		obj_array_push(wk, includes, get_obj_include_directory(wk, inc)->path);
+	}
+	obj_array_push(wk, val, includes);
+
+	const obj arrays[] = { info->libs, info->not_found_libs, info->link_args, info->compile_args };
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(arrays); ++i) {
+		obj_array_dup(wk, arrays[i], &arr);
+		obj_array_push(wk, val, arr);
+	}
+
+	return val;
+}
+
+static bool
+muon_pkgconf_info_from_cache(struct workspace *wk, obj val, struct pkgconf_info *info)
+{
+	if (!get_obj_array(wk, val)->len) {
+		// cached negative result
+		return false;
+	}
+
+	obj v, includes, inc;
+	obj_array_index(wk, val, muon_pkgconf_cache_idx_version, &v);
+	strncpy(info->version, get_cstr(wk, v), MAX_VERSION_LEN);
+
+	make_obj(wk, &info->includes, obj_array);
+	obj_array_index(wk, val, muon_pkgconf_cache_idx_includes, &includes);
+	obj_array_for(wk, includes, inc) {
+		make_obj(wk, &v, obj_include_directory);
+		struct obj_include_directory *o = get_obj_include_directory(wk, v);
+		o->path = inc;
+		o->is_system = false;
+		obj_array_push(wk, info->includes, v);
+	}
+
+	const struct {
+		enum muon_pkgconf_cache_idx idx;
+		obj *dest;
+	} arrays[] = {
+		{ muon_pkgconf_cache_idx_libs, &info->libs },
+		{ muon_pkgconf_cache_idx_not_found_libs, &info->not_found_libs },
+		{ muon_pkgconf_cache_idx_link_args, &info->link_args },
+		{ muon_pkgconf_cache_idx_compile_args, &info->compile_args },
+	};
+
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(arrays); ++i) {
+		obj_array_index(wk, val, arrays[i].idx, &v);
+		obj_array_dup(wk, v, arrays[i].dest);
+	}
+
+	return true;
+}
+
 struct find_lib_path_ctx {
 	bool is_static;
 	bool found;
@@ -207,6 +362,8 @@ apply_and_collect(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, in
 	obj str;
 	bool ret = true;
 
+	pkgconf_pkg_traverse(client, world, collect_pc_files, ctx, maxdepth, 0);
+
 	err = ctx->apply_func(client, world, &list, maxdepth);
 	if (err != PKGCONF_PKG_ERRF_OK) {
 		LOG_E("apply_func failed: %s", pkgconf_strerr(err));
@@ -293,6 +450,7 @@ muon_pkgconf_define(struct workspace *wk, const char *key, const char *value)
 	}
 
 	pkgconf_tuple_add_global(&pkgconf_ctx.client, key, value);
+	pkgconf_ctx.have_defines = true;
 
 	return true;
 }
@@ -300,6 +458,15 @@ muon_pkgconf_define(struct workspace *wk, const char *key, const char *value)
 bool
 muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgconf_info *info)
 {
+	obj cache_key = 0;
+	if (!pkgconf_ctx.have_defines) {
+		obj cached;
+		cache_key = muon_pkgconf_cache_key(wk, "lookup", get_cstr(wk, name), is_static ? "static" : "shared");
+		if (setup_cache_get(wk, cache_key, &cached)) {
+			return muon_pkgconf_info_from_cache(wk, cached, info);
+		}
+	}
+
 	if (!pkgconf_ctx.init) {
 		if (!muon_pkgconf_init(wk)) {
 			return false;
@@ -323,8 +490,16 @@ muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgco
 	pkgconf_queue_push(&pkgq, get_cstr(wk, name));
 
 	struct pkgconf_lookup_ctx ctx = { .wk = wk, .info = info, .name = name, .is_static = is_static };
+	make_obj(wk, &ctx.files, obj_array);
+	muon_pkgconf_push_search_dirs(wk, ctx.files);
 
 	if (!pkgconf_queue_apply(&pkgconf_ctx.client, &pkgq, apply_modversion, pkgconf_ctx.maxdepth, &ctx)) {
+		if (cache_key && !muon_pkgconf_pkg_exists(get_cstr(wk, name))) {
+			obj negative;
+			make_obj(wk, &negative, obj_array);
+			setup_cache_set(wk, cache_key, ctx.files, negative);
+		}
+
 		ret = false;
 		goto ret;
 	}
@@ -354,6 +529,12 @@ muon_pkgconf_lookup(struct workspace *wk, obj name, bool is_static, struct pkgco
 
 	pkgconf_client_set_flags(&pkgconf_ctx.client, flags);
 
+	if (cache_key) {
+		obj_array_extend(wk, ctx.files, ctx.libdirs);
+		obj_array_extend(wk, ctx.files, info->libs);
+		setup_cache_set(wk, cache_key, ctx.files, muon_pkgconf_info_to_cache(wk, info));
+	}
+
 ret:
 	pkgconf_queue_free(&pkgq);
 	return ret;
@@ -363,6 +544,8 @@ struct pkgconf_get_variable_ctx {
 	struct workspace *wk;
 	const char *var;
 	obj *res;
+	obj files;
+	bool applied;
 };
 
 static bool
@@ -374,7 +557,13 @@ apply_variable(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, int m
 	pkgconf_dependency_t *dep = world->required.head->data;
 	pkgconf_pkg_t *pkg = dep->match;
 
+	ctx->applied = true;
+
 	if (pkg != NULL) {
+		if (pkg->filename) {
+			obj_array_push(ctx->wk, ctx->files, make_str(ctx->wk, pkg->filename));
+		}
+
 		var = pkgconf_tuple_find(client, &pkg->vars, ctx->var);
 		if (var != NULL) {
 			*ctx->res = make_str(ctx->wk, var);
@@ -388,6 +577,20 @@ apply_variable(pkgconf_client_t *client, pkgconf_pkg_t *world, void *_ctx, int m
 bool
 muon_pkgconf_get_variable(struct workspace *wk, const char *pkg_name, const char *var, obj *res)
 {
+	obj cache_key = 0;
+	if (!pkgconf_ctx.have_defines) {
+		obj cached;
+		cache_key = muon_pkgconf_cache_key(wk, "variable", pkg_name, var);
+		if (setup_cache_get(wk, cache_key, &cached)) {
+			if (!get_obj_array(wk, cached)->len) {
+				return false;
+			}
+
+			obj_array_index(wk, cached, 0, res);
+			return true;
+		}
+	}
+
 	if (!pkgconf_ctx.init) {
 		if (!muon_pkgconf_init(wk)) {
 			return false;
@@ -405,13 +608,25 @@ muon_pkgconf_get_variable(struct workspace *wk, const char *pkg_name, const char
 		.res = res,
 		.var = var,
 	};
+	make_obj(wk, &ctx.files, obj_array);
+	muon_pkgconf_push_search_dirs(wk, ctx.files);
 
 	if (!pkgconf_queue_apply(&pkgconf_ctx.client, &pkgq, apply_variable, pkgconf_ctx.maxdepth, &ctx)) {
 		ret = false;
-		goto ret;
 	}
 
-ret:
+	// A failure is only cached if it is known to not depend on anything
+	// other than the recorded files, i.e. the package or the variable is
+	// missing.
+	if (cache_key && (ret || ctx.applied || !muon_pkgconf_pkg_exists(pkg_name))) {
+		obj cached;
+		make_obj(wk, &cached, obj_array);
+		if (ret) {
+			obj_array_push(wk, cached, *res);
+		}
+		setup_cache_set(wk, cache_key, ctx.files, cached);
+	}
+
 	pkgconf_queue_free(&pkgq);
 	return ret;
 }
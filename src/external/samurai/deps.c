@@ -184,7 +184,7 @@ samu_depsinit(struct samu_ctx *ctx, const char *builddir)
 		goto rewrite;
 	}
 
-	if (!fs_read_entire_file(depspath, &src.src)) {
+	if (!fs_read_entire_file_mapped(depspath, &src.src)) {
 		samu_warn("failed to read deps file");
 		goto rewrite;
 	}
@@ -293,6 +293,11 @@ samu_depsinit(struct samu_ctx *ctx, const char *builddir)
 	}
 
 rewrite:
+	// The old deps file may be mapped, so release it before truncating it.
+	if (free_src) {
+		fs_source_destroy(&src.src);
+	}
+
 	if (ctx->deps.depsfile) {
 		fclose(ctx->deps.depsfile);
 		ctx->deps.depsfile = NULL;
@@ -330,10 +335,6 @@ rewrite:
 	if (ferror(ctx->deps.depsfile)) {
 		samu_fatal("deps log write failed");
 	}
-
-	if (free_src) {
-		fs_source_destroy(&src.src);
-	}
 }
 
 void
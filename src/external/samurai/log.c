@@ -174,7 +174,7 @@ samu_loginit(struct samu_ctx *ctx, const char *builddir)
 	}
 
 	struct source src = { 0 };
-	if (!fs_read_entire_file(logpath, &src)) {
+	if (!fs_read_entire_file_mapped(logpath, &src)) {
 		samu_fatal("failed to read log file at %s", logpath);
 	}
 
@@ -27,7 +27,7 @@ samu_scaninit(struct samu_scanner *s, const char *path)
 		.src_i = 1,
 	};
 
-	if (!fs_read_entire_file(path, &s->src)) {
+	if (!fs_read_entire_file_mapped(path, &s->src)) {
 		samu_fatal("failed to read %s", path);
 	}
 
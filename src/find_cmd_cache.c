@@ -0,0 +1,269 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/output.h"
+#include "find_cmd_cache.h"
+#include "lang/object_iterators.h"
+#include "lang/serial.h"
+#include "log.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+#include "tracy.h"
+
+/*
+ * find_program() is typically called many times per setup, often with
+ * several fallback names, and each lookup would otherwise stat every entry in
+ * PATH.  Instead, every PATH directory is listed once and the listing is
+ * stored along with the directory's mtime.  Lookups (including misses) for a
+ * given PATH are memoized in find_cmd_cache.results.
+ *
+ * The listings are written to the private dir by the backend and reused by
+ * the next setup for every directory whose mtime has not changed.
+ */
+
+static void
+find_cmd_cache_push_key(struct workspace *wk, struct sbuf *buf, const char *name)
+{
+	sbuf_clear(buf);
+	sbuf_pushs(wk, buf, name);
+#ifdef _WIN32
+	// file names are case insensitive on windows
+	struct str s = { .s = buf->buf, .len = buf->len };
+	str_to_lower(&s);
+#endif
+}
+
+struct find_cmd_cache_list_ctx {
+	struct workspace *wk;
+	struct sbuf *buf;
+	obj names;
+};
+
+static enum iteration_result
+find_cmd_cache_list_iter(void *_ctx, const char *name)
+{
+	struct find_cmd_cache_list_ctx *ctx = _ctx;
+
+	find_cmd_cache_push_key(ctx->wk, ctx->buf, name);
+	obj s = make_strn(ctx->wk, ctx->buf->buf, ctx->buf->len);
+	obj_dict_set(ctx->wk, ctx->names, s, s);
+	return ir_cont;
+}
+
+/*
+ * Returns a dict of names contained in dir, or 0 if the directory could not be
+ * listed, in which case the caller must fall back to checking paths directly.
+ */
+static obj
+find_cmd_cache_get_dir(struct workspace *wk, const char *dir)
+{
+	obj entry, names;
+	if (obj_dict_index_str(wk, wk->find_cmd_cache.dirs, dir, &entry)) {
+		obj_array_index(wk, entry, 1, &names);
+		return names;
+	}
+
+	// Relative PATH entries depend on the cwd and are never cached
+	if (!path_is_absolute(dir)) {
+		return 0;
+	}
+
+	int64_t mtime = 0;
+	switch (fs_mtime(dir, &mtime)) {
+	case fs_mtime_result_ok: break;
+	case fs_mtime_result_not_found: mtime = -1; break;
+	case fs_mtime_result_err: return 0;
+	}
+
+	make_obj(wk, &names, obj_dict);
+
+	obj prev = 0;
+	if (obj_dict_index_str(wk, wk->find_cmd_cache.prev_dirs, dir, &prev)) {
+		obj prev_mtime;
+		obj_array_index(wk, prev, 0, &prev_mtime);
+		if (get_obj_number(wk, prev_mtime) != mtime) {
+			prev = 0;
+		}
+	}
+
+	if (prev) {
+		obj v, prev_names;
+		obj_array_index(wk, prev, 1, &prev_names);
+		obj_array_for(wk, prev_names, v) {
+			obj_dict_set(wk, names, v, v);
+		}
+	} else if (mtime != -1) {
+		if (!fs_dir_exists(dir)) {
+			return 0;
+		}
+
+		SBUF(buf);
+		struct find_cmd_cache_list_ctx ctx = { .wk = wk, .buf = &buf, .names = names };
+		if (!fs_dir_foreach(dir, &ctx, find_cmd_cache_list_iter)) {
+			names = 0;
+		}
+	}
+
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, make_number(wk, mtime));
+	obj_array_push(wk, entry, names);
+	obj_dict_set(wk, wk->find_cmd_cache.dirs, make_str(wk, dir), entry);
+	return names;
+}
+
+static bool
+find_cmd_cache_check_dir(struct workspace *wk, struct sbuf *buf, const char *dir, uint32_t dir_len, const char *cmd)
+{
+	SBUF(key);
+	sbuf_pushn(wk, &key, dir, dir_len);
+	obj names = find_cmd_cache_get_dir(wk, key.buf);
+
+	sbuf_clear(buf);
+	sbuf_pushn(wk, buf, dir, dir_len);
+	path_push(wk, buf, cmd);
+
+	obj _;
+	find_cmd_cache_push_key(wk, &key, cmd);
+	if (!names || obj_dict_index_strn(wk, names, key.buf, key.len, &_)) {
+		if (fs_exe_exists(buf->buf)) {
+			return true;
+		}
+	}
+
+#ifdef _WIN32
+	if (!fs_has_extension(buf->buf, ".exe")) {
+		sbuf_pushs(wk, buf, ".exe");
+		sbuf_pushs(wk, &key, ".exe");
+		if (!names || obj_dict_index_strn(wk, names, key.buf, key.len, &_)) {
+			if (fs_exe_exists(buf->buf)) {
+				return true;
+			}
+		}
+	}
+#endif
+
+	return false;
+}
+
+static bool
+find_cmd_cache_search_path(struct workspace *wk, struct sbuf *buf, const char *env_path, const char *cmd)
+{
+	const char *base_start = env_path;
+	while (true) {
+		if (!*env_path || *env_path == ENV_PATH_SEP) {
+			if (find_cmd_cache_check_dir(wk, buf, base_start, env_path - base_start, cmd)) {
+				return true;
+			}
+
+			if (!*env_path) {
+				break;
+			}
+
+			base_start = env_path + 1;
+		}
+
+		++env_path;
+	}
+
+	return false;
+}
+
+bool
+find_cmd_cached(struct workspace *wk, struct sbuf *buf, const char *cmd)
+{
+	const char *env_path;
+
+	// The cache is not available in bare workspaces, e.g. for internal eval
+	if (!wk->find_cmd_cache.dirs || !path_is_basename(cmd) || !(env_path = getenv("PATH"))) {
+		return fs_find_cmd(wk, buf, cmd);
+	}
+
+	TracyCZoneAutoS;
+
+	if (!wk->find_cmd_cache.env_path || strcmp(get_cstr(wk, wk->find_cmd_cache.env_path), env_path) != 0) {
+		wk->find_cmd_cache.env_path = make_str(wk, env_path);
+		make_obj(wk, &wk->find_cmd_cache.results, obj_dict);
+	}
+
+	bool found;
+	obj res;
+	if (obj_dict_index_str(wk, wk->find_cmd_cache.results, cmd, &res)) {
+		sbuf_clear(buf);
+		if ((found = !!res)) {
+			sbuf_pushs(wk, buf, get_cstr(wk, res));
+		}
+	} else {
+		found = find_cmd_cache_search_path(wk, buf, env_path, cmd);
+		obj_dict_set(wk, wk->find_cmd_cache.results, make_str(wk, cmd), found ? make_str(wk, buf->buf) : 0);
+	}
+
+	TracyCZoneAutoE;
+	return found;
+}
+
+bool
+find_cmd_cache_load(struct workspace *wk)
+{
+	SBUF(path);
+	path_join(wk, &path, wk->muon_private, output_path.find_cmd_cache);
+
+	if (!fs_file_exists(path.buf)) {
+		return true;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path.buf, "rb"))) {
+		return false;
+	}
+
+	bool ret = serial_load(wk, &wk->find_cmd_cache.prev_dirs, f);
+
+	if (!fs_fclose(f)) {
+		ret = false;
+	}
+
+	if (!ret || get_obj_type(wk, wk->find_cmd_cache.prev_dirs) != obj_dict) {
+		make_obj(wk, &wk->find_cmd_cache.prev_dirs, obj_dict);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+find_cmd_cache_dump(struct workspace *wk, void *_ctx, FILE *out)
+{
+	obj dirs, dir, entry;
+	make_obj(wk, &dirs, obj_dict);
+
+	obj_dict_for(wk, wk->find_cmd_cache.dirs, dir, entry) {
+		obj mtime, names;
+		obj_array_index(wk, entry, 0, &mtime);
+		obj_array_index(wk, entry, 1, &names);
+
+		if (!names) {
+			continue;
+		}
+
+		obj list, name, _;
+		make_obj(wk, &list, obj_array);
+		obj_dict_for(wk, names, name, _) {
+			obj_array_push(wk, list, name);
+		}
+
+		obj dumped;
+		make_obj(wk, &dumped, obj_array);
+		obj_array_push(wk, dumped, mtime);
+		obj_array_push(wk, dumped, list);
+		obj_dict_set(wk, dirs, dir, dumped);
+	}
+
+	return serial_dump(wk, dirs, out);
+}
@@ -0,0 +1,244 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fs_cache.h"
+#include "lang/object_iterators.h"
+#include "platform/path.h"
+
+/*
+ * Filesystem queries made while interpreting build files, e.g. by the fs
+ * module, files(), and source validation in build targets, are answered from
+ * a cache that lives for the duration of a setup.  Each path is checked at
+ * most once per query kind, and a directory is listed at most once.  This
+ * matters most on slow (e.g. network mounted) source trees.
+ *
+ * Files that muon itself writes during setup are forgotten with
+ * fs_cache_forget(), and anything that runs an external command, which might
+ * modify the filesystem arbitrarily, invalidates the whole cache.
+ */
+
+enum fs_cache_flag {
+	fs_cache_flag_exists_known = 1 << 0,
+	fs_cache_flag_exists = 1 << 1,
+	fs_cache_flag_file_known = 1 << 2,
+	fs_cache_flag_file = 1 << 3,
+	fs_cache_flag_dir_known = 1 << 4,
+	fs_cache_flag_dir = 1 << 5,
+};
+
+typedef bool((*fs_cache_lookup_func)(const char *));
+
+static bool
+fs_cache_lookup(struct workspace *wk, const char *path, enum fs_cache_flag flag, fs_cache_lookup_func lookup)
+{
+	// The cache is not available in bare workspaces, e.g. for internal eval
+	if (!wk->fs_cache.stat) {
+		return lookup(path);
+	}
+
+	// Each flag's known bit is the bit below it
+	const enum fs_cache_flag known = flag >> 1;
+
+	obj v;
+	int64_t flags = 0;
+	if (obj_dict_index_str(wk, wk->fs_cache.stat, path, &v)) {
+		flags = get_obj_number(wk, v);
+	} else {
+		v = make_number(wk, 0);
+		obj_dict_set(wk, wk->fs_cache.stat, make_str(wk, path), v);
+	}
+
+	if (!(flags & known)) {
+		flags |= known;
+
+		if (lookup(path)) {
+			flags |= flag;
+
+			// Anything that is a file or a directory exists, and
+			// is not the other kind.
+			if (flag != fs_cache_flag_exists) {
+				flags |= fs_cache_flag_exists_known | fs_cache_flag_exists;
+				flags |= flag == fs_cache_flag_file ? fs_cache_flag_dir_known : fs_cache_flag_file_known;
+			}
+		} else if (flag == fs_cache_flag_exists) {
+			flags |= fs_cache_flag_file_known | fs_cache_flag_dir_known;
+		}
+
+		set_obj_number(wk, v, flags);
+	}
+
+	return flags & flag;
+}
+
+bool
+fs_cache_exists(struct workspace *wk, const char *path)
+{
+	return fs_cache_lookup(wk, path, fs_cache_flag_exists, fs_exists);
+}
+
+bool
+fs_cache_file_exists(struct workspace *wk, const char *path)
+{
+	return fs_cache_lookup(wk, path, fs_cache_flag_file, fs_file_exists);
+}
+
+bool
+fs_cache_dir_exists(struct workspace *wk, const char *path)
+{
+	return fs_cache_lookup(wk, path, fs_cache_flag_dir, fs_dir_exists);
+}
+
+/*
+ * Returns [size, dev, ino] for path, or 0 if it could not be stat'd.
+ */
+static obj
+fs_cache_stat(struct workspace *wk, const char *path)
+{
+	obj entry;
+	if (wk->fs_cache.stat_res && obj_dict_index_str(wk, wk->fs_cache.stat_res, path, &entry)) {
+		return entry;
+	}
+
+	struct stat sb;
+	if (!fs_stat(path, &sb)) {
+		return 0;
+	}
+
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, make_number(wk, sb.st_size));
+	obj_array_push(wk, entry, make_number(wk, sb.st_dev));
+	obj_array_push(wk, entry, make_number(wk, sb.st_ino));
+
+	if (wk->fs_cache.stat_res) {
+		obj_dict_set(wk, wk->fs_cache.stat_res, make_str(wk, path), entry);
+	}
+
+	return entry;
+}
+
+static int64_t
+fs_cache_stat_field(struct workspace *wk, obj entry, uint32_t i)
+{
+	obj v;
+	obj_array_index(wk, entry, i, &v);
+	return get_obj_number(wk, v);
+}
+
+bool
+fs_cache_size(struct workspace *wk, const char *path, uint64_t *size)
+{
+	obj entry;
+	if (!(entry = fs_cache_stat(wk, path))) {
+		return false;
+	}
+
+	*size = fs_cache_stat_field(wk, entry, 0);
+	return true;
+}
+
+/*
+ * Paths are expected to be normalized.  Distinct paths refer to the same file
+ * if both exist and have the same device and inode, e.g. through a symlink.
+ */
+bool
+fs_cache_is_samepath(struct workspace *wk, const char *a, const char *b)
+{
+	if (strcmp(a, b) == 0) {
+		return true;
+	}
+
+#ifdef _WIN32
+	// st_ino is not meaningful on windows
+	return false;
+#else
+	if (!fs_cache_exists(wk, a) || !fs_cache_exists(wk, b)) {
+		return false;
+	}
+
+	obj ea, eb;
+	if (!(ea = fs_cache_stat(wk, a)) || !(eb = fs_cache_stat(wk, b))) {
+		return false;
+	}
+
+	return fs_cache_stat_field(wk, ea, 1) == fs_cache_stat_field(wk, eb, 1)
+	       && fs_cache_stat_field(wk, ea, 2) == fs_cache_stat_field(wk, eb, 2);
+#endif
+}
+
+struct fs_cache_list_ctx {
+	struct workspace *wk;
+	obj names;
+};
+
+static enum iteration_result
+fs_cache_list_iter(void *_ctx, const char *name)
+{
+	struct fs_cache_list_ctx *ctx = _ctx;
+	obj_array_push(ctx->wk, ctx->names, make_str(ctx->wk, name));
+	return ir_cont;
+}
+
+bool
+fs_cache_dir_foreach(struct workspace *wk, const char *path, void *_ctx, fs_dir_foreach_cb cb)
+{
+	if (!wk->fs_cache.dirs) {
+		return fs_dir_foreach(path, _ctx, cb);
+	}
+
+	obj names;
+	if (!obj_dict_index_str(wk, wk->fs_cache.dirs, path, &names)) {
+		make_obj(wk, &names, obj_array);
+
+		struct fs_cache_list_ctx ctx = { .wk = wk, .names = names };
+		if (!fs_dir_foreach(path, &ctx, fs_cache_list_iter)) {
+			return false;
+		}
+
+		obj_dict_set(wk, wk->fs_cache.dirs, make_str(wk, path), names);
+	}
+
+	obj name;
+	obj_array_for(wk, names, name) {
+		switch (cb(_ctx, get_cstr(wk, name))) {
+		case ir_err: return false;
+		case ir_done: return true;
+		case ir_cont: break;
+		}
+	}
+
+	return true;
+}
+
+void
+fs_cache_forget(struct workspace *wk, const char *path)
+{
+	if (!wk->fs_cache.stat) {
+		return;
+	}
+
+	obj_dict_del_str(wk, wk->fs_cache.stat, path);
+	obj_dict_del_str(wk, wk->fs_cache.stat_res, path);
+
+	SBUF(dir);
+	path_dirname(wk, &dir, path);
+	obj_dict_del_str(wk, wk->fs_cache.dirs, dir.buf);
+}
+
+void
+fs_cache_invalidate(struct workspace *wk)
+{
+	if (!wk->fs_cache.stat) {
+		return;
+	}
+
+	make_obj(wk, &wk->fs_cache.stat, obj_dict);
+	make_obj(wk, &wk->fs_cache.stat_res, obj_dict);
+	make_obj(wk, &wk->fs_cache.dirs, obj_dict);
+}
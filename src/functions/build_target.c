@@ -9,11 +9,13 @@
 #include <string.h>
 
 #include "args.h"
+#include "backend/unity.h"
 #include "coerce.h"
 #include "error.h"
 #include "functions/build_target.h"
 #include "functions/generator.h"
 #include "lang/func_lookup.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "log.h"
 #include "platform/path.h"
@@ -112,6 +114,8 @@ struct build_target_extract_objects_ctx {
 	struct obj_build_target *tgt;
 	obj tgt_id;
 	obj *res;
+	obj unity_srcs;
+	bool all;
 };
 
 static enum iteration_result
@@ -182,6 +186,19 @@ build_target_extract_objects_iter(struct workspace *wk, void *_ctx, obj val)
 		return ir_err;
 	}
 
+	if (ctx->unity_srcs && obj_dict_in(wk, ctx->unity_srcs, *get_obj_file(wk, file))) {
+		if (!ctx->all) {
+			vm_error_at(wk,
+				ctx->err_node,
+				"single object files cannot be extracted from unity builds, use extract_all_objects()");
+			return ir_err;
+		}
+
+		// The unity objects have already been added by
+		// build_target_extract_all_objects
+		return ir_cont;
+	}
+
 	SBUF(dest_path);
 	if (!tgt_src_to_object_path(wk, ctx->tgt, file, false, &dest_path)) {
 		return ir_err;
@@ -206,6 +223,9 @@ build_target_extract_objects(struct workspace *wk, obj self, uint32_t err_node,
 		.tgt_id = self,
 	};
 
+	obj batches;
+	unity_batches(wk, ctx.tgt, &batches, &ctx.unity_srcs);
+
 	return obj_array_foreach_flat(wk, arr, &ctx, build_target_extract_objects_iter);
 }
 
@@ -238,8 +258,27 @@ build_target_extract_all_objects(struct workspace *wk, uint32_t ip, obj self, ob
 		.res = res,
 		.tgt = get_obj_build_target(wk, self),
 		.tgt_id = self,
+		.all = true,
 	};
 
+	obj batches;
+	if (unity_batches(wk, ctx.tgt, &batches, &ctx.unity_srcs)) {
+		obj batch, unity_file;
+		obj_array_for(wk, batches, batch) {
+			obj_array_index(wk, batch, 0, &unity_file);
+
+			SBUF(dest_path);
+			if (!tgt_src_to_object_path(wk, ctx.tgt, unity_file, false, &dest_path)) {
+				return false;
+			}
+
+			obj new_file;
+			make_obj(wk, &new_file, obj_file);
+			*get_obj_file(wk, new_file) = sbuf_into_str(wk, &dest_path);
+			obj_array_push(wk, *res, new_file);
+		}
+	}
+
 	if (!obj_array_foreach_flat(wk, ctx.tgt->src, &ctx, build_target_extract_all_objects_iter)) {
 		return false;
 	}
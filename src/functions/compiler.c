@@ -29,6 +29,7 @@
 #include "platform/path.h"
 #include "platform/run_cmd.h"
 #include "sha_256.h"
+#include "time_report.h"
 
 enum compile_mode {
 	compile_mode_preprocess,
@@ -49,6 +50,9 @@ struct compiler_check_opts {
 
 	bool from_cache;
 	obj cache_key, cache_val;
+
+	// accumulated time spent in compiler_check(), for the time report
+	float elapsed;
 };
 
 static const char *
@@ -90,6 +94,16 @@ compiler_check_log(struct workspace *wk, struct compiler_check_opts *opts, const
 	log_plain("\n");
 
 	va_end(args);
+
+	if (time_report_enabled(wk)) {
+		va_start(args, fmt);
+		time_report_push(wk,
+			time_report_kind_compiler_check,
+			make_strfv(wk, fmt, args),
+			opts->elapsed,
+			opts->from_cache ? time_report_cached_hit : time_report_cached_miss);
+		va_end(args);
+	}
 }
 
 static void
@@ -164,7 +178,35 @@ compiler_check_cache(struct workspace *wk,
 
 	uint8_t sha[sha_len] = { 0 };
 
-	calc_sha_256(&sha[sha_idx_argstr], argstr, argstr_len);
+	if (wk->subproject_workers.parent_private) {
+		// Subproject workers run checks in their own private dir, see
+		// subproject_workers.c, but must produce the same keys as the
+		// parent would.
+		const char *priv = wk->muon_private, *parent_priv = wk->subproject_workers.parent_private;
+		uint32_t priv_len = strlen(priv), i;
+		struct sha_256 sha_256;
+		sha_256_init(&sha_256, &sha[sha_idx_argstr]);
+
+		const char *p = argstr;
+		for (i = 0; i < argc; ++i) {
+			uint32_t len = strlen(p);
+			if (strncmp(p, priv, priv_len) == 0) {
+				sha_256_write(&sha_256, parent_priv, strlen(parent_priv));
+				sha_256_write(&sha_256, p + priv_len, len - priv_len);
+			} else {
+				sha_256_write(&sha_256, p, len);
+			}
+
+			if (i + 1 < argc) {
+				sha_256_write(&sha_256, "", 1);
+			}
+			p += len + 1;
+		}
+
+		(void)sha_256_close(&sha_256);
+	} else {
+		calc_sha_256(&sha[sha_idx_argstr], argstr, argstr_len);
+	}
 
 	if (comp->ver) {
 		const struct str *ver = get_str(wk, comp->ver);
@@ -220,7 +262,11 @@ set_compiler_cache(struct workspace *wk, obj key, bool res, obj val)
 }
 
 static bool
-compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const char *src, uint32_t err_node, bool *res)
+compiler_check_run(struct workspace *wk,
+	struct compiler_check_opts *opts,
+	const char *src,
+	uint32_t err_node,
+	bool *res)
 {
 	enum requirement_type req = requirement_auto;
 	if (opts->required && opts->required->set) {
@@ -403,6 +449,18 @@ ret:
 	return ret;
 }
 
+static bool
+compiler_check(struct workspace *wk, struct compiler_check_opts *opts, const char *src, uint32_t err_node, bool *res)
+{
+	struct timer t;
+	time_report_start(wk, &t);
+	bool ret = compiler_check_run(wk, opts, src, err_node, res);
+	if (time_report_enabled(wk)) {
+		opts->elapsed += timer_read(&t);
+	}
+	return ret;
+}
+
 static int64_t
 compiler_check_parse_output_int(struct compiler_check_opts *opts)
 {
@@ -14,6 +14,8 @@
 #include "coerce.h"
 #include "error.h"
 #include "external/samurai.h"
+#include "find_cmd_cache.h"
+#include "fs_cache.h"
 #include "functions/environment.h"
 #include "functions/external_program.h"
 #include "functions/kernel.h"
@@ -36,6 +38,8 @@
 #include "platform/mem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "subproject_workers.h"
+#include "time_report.h"
 #include "wrap.h"
 
 static bool
@@ -518,7 +522,7 @@ find_program_custom_dir_iter(struct workspace *wk, void *_ctx, obj val)
 
 	path_join(wk, ctx->buf, get_cstr(wk, val), ctx->prog);
 
-	if (fs_file_exists(ctx->buf->buf)) {
+	if (fs_cache_file_exists(wk, ctx->buf->buf)) {
 		ctx->found = true;
 		return ir_done;
 	}
@@ -687,13 +691,13 @@ find_program_step_4:
 	/* 5. Project's source tree relative to the current subdir */
 	/*       If you use the return value of configure_file(), the current subdir inside the build tree is used instead */
 	path_join(wk, &buf, workspace_cwd(wk), str);
-	if (fs_file_exists(buf.buf)) {
+	if (fs_cache_file_exists(wk, buf.buf)) {
 		path = buf.buf;
 		goto found;
 	}
 
 	/* 6. PATH environment variable */
-	if (fs_find_cmd(wk, &buf, str)) {
+	if (find_cmd_cached(wk, &buf, str)) {
 		path = buf.buf;
 		goto found;
 	}
@@ -1059,6 +1063,7 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 
 	const char *argstr, *envstr;
 	uint32_t argc, envc;
+	obj args;
 
 	{
 		obj arg0;
@@ -1093,7 +1098,6 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 			obj_array_set(wk, an[0].val, 0, cmd_file);
 		}
 
-		obj args;
 		if (!arr_to_args(wk, arr_to_args_external_program, an[0].val, &args)) {
 			return false;
 		}
@@ -1116,7 +1120,20 @@ func_run_command(struct workspace *wk, obj _, obj *res)
 	bool ret = false;
 	struct run_cmd_ctx cmd_ctx = { 0 };
 
-	if (!run_cmd(&cmd_ctx, argstr, argc, envstr, envc)) {
+	subproject_workers_before_command(wk);
+
+	struct timer t;
+	time_report_start(wk, &t);
+	bool ran = run_cmd(&cmd_ctx, argstr, argc, envstr, envc);
+	// The command may have touched anything, e.g. generated sources
+	fs_cache_invalidate(wk);
+	if (time_report_enabled(wk)) {
+		obj cmd;
+		obj_array_join(wk, false, args, make_str(wk, " "), &cmd);
+		time_report_end(wk, &t, time_report_kind_run_command, cmd);
+	}
+
+	if (!ran) {
 		vm_error(wk, "%s", cmd_ctx.err_msg);
 		if (cmd_ctx.out.len) {
 			log_plain("stdout:\n%s", cmd_ctx.out.buf);
@@ -1264,7 +1281,15 @@ func_subdir(struct workspace *wk, obj _, obj *res)
 	wk->vm.dbg_state.eval_trace_subdir = true;
 
 	path_push(wk, &new_cwd, "meson.build");
+
+	struct timer t;
+	time_report_start(wk, &t);
 	ret = wk->vm.behavior.eval_project_file(wk, new_cwd.buf, false);
+	if (time_report_enabled(wk)) {
+		SBUF(rel);
+		path_relative_to(wk, &rel, wk->source_root, new_cwd.buf);
+		time_report_end(wk, &t, time_report_kind_subdir, sbuf_into_str(wk, &rel));
+	}
 
 ret:
 	current_project(wk)->cwd = old_cwd;
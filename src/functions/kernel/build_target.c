@@ -18,6 +18,7 @@
 #include "functions/kernel/build_target.h"
 #include "functions/kernel/dependency.h"
 #include "install.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "log.h"
 #include "machines.h"
@@ -504,6 +505,7 @@ create_target(struct workspace *wk,
 	struct obj_build_target *tgt = get_obj_build_target(wk, *res);
 	tgt->type = type;
 	tgt->name = an[0].val;
+	tgt->project_id = wk->cur_project;
 	tgt->cwd = current_project(wk)->cwd;
 	tgt->build_dir = current_project(wk)->build_dir;
 	make_obj(wk, &tgt->args, obj_dict);
@@ -757,6 +759,64 @@ create_target(struct workspace *wk,
 		}
 	}
 
+	{ // precompiled headers
+		static struct {
+			enum build_target_kwargs kw;
+			enum compiler_language l;
+		} lang_pch[] = {
+			{ bt_kw_c_pch, compiler_language_c },
+			{ bt_kw_cpp_pch, compiler_language_cpp },
+			{ bt_kw_objc_pch, compiler_language_objc },
+			{ bt_kw_objcpp_pch, compiler_language_objcpp },
+		};
+
+		uint32_t i;
+		for (i = 0; i < ARRAY_LEN(lang_pch); ++i) {
+			if (!akw[lang_pch[i].kw].set) {
+				continue;
+			}
+
+			// Either a header, or a header and a source to create the
+			// precompiled header from, in any order.
+			obj files;
+			if (!coerce_files(wk, akw[lang_pch[i].kw].node, akw[lang_pch[i].kw].val, &files)) {
+				return false;
+			}
+
+			uint32_t len = get_obj_array(wk, files)->len;
+			obj header = 0, src = 0, file;
+			obj_array_for(wk, files, file) {
+				enum compiler_language l;
+				if (filename_to_compiler_language(get_file_path(wk, file), &l) && languages[l].is_header) {
+					header = file;
+				} else {
+					src = file;
+				}
+			}
+
+			if (len < 1 || len > 2 || !header || (len == 2 && !src)) {
+				vm_error_at(wk,
+					akw[lang_pch[i].kw].node,
+					"%s must be a header, optionally followed by a source",
+					akw[lang_pch[i].kw].key);
+				return false;
+			}
+
+			obj pch;
+			make_obj(wk, &pch, obj_array);
+			obj_array_push(wk, pch, header);
+			if (src) {
+				obj_array_push(wk, pch, src);
+			}
+
+			if (!tgt->pch) {
+				make_obj(wk, &tgt->pch, obj_dict);
+			}
+
+			obj_dict_seti(wk, tgt->pch, lang_pch[i].l, pch);
+		}
+	}
+
 	obj soname_install = 0, plain_name_install = 0;
 
 	// soname handling
@@ -825,6 +885,7 @@ create_target(struct workspace *wk,
 		}
 
 		install_tgt->build_target = true;
+		tgt->install_target = obj_array_get_tail(wk, wk->install);
 
 		if (soname_install) {
 			push_install_target_install_dir(wk, soname_install, install_dir, akw[bt_kw_install_mode].val);
@@ -894,6 +955,54 @@ typecheck_string_or_empty_array(struct workspace *wk, struct args_kw *kw)
 	}
 }
 
+static obj
+both_libs_lang_args(struct args_kw *akw, enum build_target_kwargs args, enum build_target_kwargs type_args)
+{
+	if (akw[type_args].set) {
+		return akw[type_args].val;
+	} else if (akw[args].set) {
+		return akw[args].val;
+	}
+
+	return 0;
+}
+
+/*
+ * The shared half of both_libraries() links the static half's objects instead
+ * of compiling its sources again, as long as they would have been compiled
+ * the same way.  This requires the static objects to be pic, and the
+ * <lang>_static_args and <lang>_shared_args to agree.
+ */
+static bool
+both_libs_can_share_objects(struct workspace *wk, struct args_kw *akw, obj static_lib)
+{
+	if (!(get_obj_build_target(wk, static_lib)->flags & build_tgt_flag_pic)) {
+		return false;
+	}
+
+	static const struct {
+		enum build_target_kwargs args, static_args, shared_args;
+	} lang_args[] = {
+#define TOOLCHAIN_ENUM(lang) { bt_kw_##lang##_args, bt_kw_##lang##_static_args, bt_kw_##lang##_shared_args },
+		FOREACH_COMPILER_EXPOSED_LANGUAGE(TOOLCHAIN_ENUM)
+#undef TOOLCHAIN_ENUM
+	};
+
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(lang_args); ++i) {
+		obj st = both_libs_lang_args(akw, lang_args[i].args, lang_args[i].static_args),
+		    sh = both_libs_lang_args(akw, lang_args[i].args, lang_args[i].shared_args);
+
+		if (st == sh) {
+			continue;
+		} else if (!st || !sh || !obj_equal(wk, st, sh)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static bool
 tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type argtype, bool tgt_type_from_kw)
 {
@@ -938,7 +1047,7 @@ tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type arg
 #define E(lang, s, t) [bt_kw_##lang##s] = { #lang #s, t }
 #define TOOLCHAIN_ENUM(lang)                                                                                 \
 	E(lang, _args, TYPE_TAG_LISTIFY | obj_string), E(lang, _static_args, TYPE_TAG_LISTIFY | obj_string), \
-		E(lang, _shared_args, TYPE_TAG_LISTIFY | obj_string), E(lang, _pch, tc_string | tc_file),
+		E(lang, _shared_args, TYPE_TAG_LISTIFY | obj_string), E(lang, _pch, TYPE_TAG_LISTIFY | tc_string | tc_file),
 		FOREACH_COMPILER_EXPOSED_LANGUAGE(TOOLCHAIN_ENUM)
 #undef TOOLCHAIN_ENUM
 #undef E
@@ -983,13 +1092,7 @@ tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type arg
 		return false;
 	}
 
-	if (type == (tgt_static_library | tgt_dynamic_library) && !akw[bt_kw_pic].set) {
-		make_obj(wk, &akw[bt_kw_pic].val, obj_bool);
-		set_obj_bool(wk, akw[bt_kw_pic].val, true);
-		akw[bt_kw_pic].set = true;
-	}
-
-	bool multi_target = false;
+	bool multi_target = false, share_objects = false;
 	obj tgt = 0;
 
 	for (i = 0; i <= tgt_type_count; ++i) {
@@ -1006,23 +1109,31 @@ tgt_common(struct workspace *wk, obj *res, enum tgt_type type, enum tgt_type arg
 
 			// If this target is a multi-target (both_libraries),
 			// set the objects argument with objects from the
-			// previous target
+			// previous target if they can be shared, otherwise
+			// compile the sources again.
 
-			obj objects;
-			if (!build_target_extract_all_objects(wk, an[0].node, tgt, &objects, true)) {
-				return false;
-			}
+			share_objects = both_libs_can_share_objects(wk, akw, tgt);
 
-			if (akw[bt_kw_objects].set) {
-				obj_array_extend(wk, akw[bt_kw_objects].val, objects);
-			} else {
-				akw[bt_kw_objects].set = true;
-				akw[bt_kw_objects].val = objects;
-				akw[bt_kw_objects].node = an[0].node;
+			if (share_objects) {
+				obj objects;
+				if (!build_target_extract_all_objects(wk, an[0].node, tgt, &objects, true)) {
+					return false;
+				}
+
+				if (akw[bt_kw_objects].set) {
+					obj_array_extend(wk, akw[bt_kw_objects].val, objects);
+				} else {
+					akw[bt_kw_objects].set = true;
+					akw[bt_kw_objects].val = objects;
+					akw[bt_kw_objects].node = an[0].node;
+				}
+			} else if (akw[bt_kw_pic].set && !get_obj_bool(wk, akw[bt_kw_pic].val)) {
+				// pic: false only applies to the static half
+				akw[bt_kw_pic].set = false;
 			}
 		}
 
-		if (!create_target(wk, an, akw, t, multi_target, &tgt)) {
+		if (!create_target(wk, an, akw, t, share_objects, &tgt)) {
 			return false;
 		}
 
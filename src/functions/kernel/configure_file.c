@@ -13,6 +13,7 @@
 #include "buf_size.h"
 #include "coerce.h"
 #include "error.h"
+#include "fs_cache.h"
 #include "functions/environment.h"
 #include "functions/kernel/configure_file.h"
 #include "functions/kernel/custom_target.h"
@@ -25,6 +26,7 @@
 #include "platform/mem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "subproject_workers.h"
 
 enum configure_file_output_format {
 	configure_file_output_format_c,
@@ -32,23 +34,6 @@ enum configure_file_output_format {
 	configure_file_output_format_json,
 };
 
-static bool
-file_exists_with_content(struct workspace *wk, const char *dest, const char *out_buf, uint32_t out_len)
-{
-	if (fs_file_exists(dest)) {
-		struct source src = { 0 };
-		if (fs_read_entire_file(dest, &src)) {
-			bool eql = out_len == src.len && memcmp(out_buf, src.src, src.len) == 0;
-
-			fs_source_destroy(&src);
-
-			return eql;
-		}
-	}
-
-	return false;
-}
-
 static void
 configure_file_skip_whitespace(const struct source *src, uint32_t *i)
 {
@@ -72,6 +57,40 @@ configure_var_len(const char *p)
 	return i;
 }
 
+/*
+ * Returns the offset of the first occurrence of a, b, or c in s, or len if
+ * there is none.  The bulk of a configured file is usually copied through
+ * unchanged, so the input is checked 8 bytes at a time.
+ */
+static uint32_t
+configure_file_scan(const char *s, uint32_t len, char a, char b, char c)
+{
+	const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+	const uint64_t ma = ones * (uint8_t)a, mb = ones * (uint8_t)b, mc = ones * (uint8_t)c;
+	uint32_t i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		uint64_t v, x, y, z;
+		memcpy(&v, &s[i], 8);
+		x = v ^ ma;
+		y = v ^ mb;
+		z = v ^ mc;
+
+		// Non-zero if any byte of x, y, or z is zero
+		if ((((x - ones) & ~x) | ((y - ones) & ~y) | ((z - ones) & ~z)) & highs) {
+			break;
+		}
+	}
+
+	for (; i < len; ++i) {
+		if (s[i] == a || s[i] == b || s[i] == c) {
+			break;
+		}
+	}
+
+	return i;
+}
+
 enum configure_file_syntax {
 	configure_file_syntax_mesondefine = 0 << 0,
 	configure_file_syntax_cmakedefine = 1 << 0,
@@ -116,16 +135,13 @@ substitute_config(struct workspace *wk,
 	SBUF_manual(out_buf);
 
 	struct source_location location = { 0, 1 }, id_location;
-	uint32_t i, id_start, id_len, col = 0, orig_i;
+	uint32_t i, id_start, id_len, orig_i;
 	obj elem;
 	char tmp_buf[BUF_SIZE_1k] = { 0 };
 
 	for (i = 0; i < src.len; ++i) {
-		if (src.src[i] == '\n') {
-			col = i + 1;
-		}
-
-		if (i == col && strncmp(&src.src[i], define, define_len) == 0) {
+		if (src.src[i] == '#' && (i == 0 || src.src[i - 1] == '\n')
+			&& strncmp(&src.src[i], define, define_len) == 0) {
 			i += define_len;
 
 			configure_file_skip_whitespace(&src, &i);
@@ -298,14 +314,19 @@ write_mesondefine:
 			const struct str *ss = get_str(wk, sub);
 			sbuf_pushn(wk, &out_buf, ss->s, ss->len);
 		} else {
-			sbuf_pushn(wk, &out_buf, &src.src[i], 1);
+			// Copy everything up to the next character that might
+			// start a substitution.
+			uint32_t run = configure_file_scan(&src.src[i + 1], src.len - (i + 1), '#', '\\', *varstart);
+			sbuf_pushn(wk, &out_buf, &src.src[i], run + 1);
+			i += run;
 		}
 	}
 
-	if (file_exists_with_content(wk, get_cstr(wk, out), out_buf.buf, out_buf.len)) {
+	if (fs_file_has_content(get_cstr(wk, out), (uint8_t *)out_buf.buf, out_buf.len)) {
 		goto cleanup;
 	}
 
+	fs_cache_forget(wk, get_cstr(wk, out));
 	if (!fs_write(get_cstr(wk, out), (uint8_t *)out_buf.buf, out_buf.len)) {
 		ret = false;
 		goto cleanup;
@@ -429,7 +450,8 @@ generate_config(struct workspace *wk,
 		sbuf_pushs(wk, &out_buf, "}\n");
 	}
 
-	if (!file_exists_with_content(wk, get_cstr(wk, out_path), out_buf.buf, out_buf.len)) {
+	if (!fs_file_has_content(get_cstr(wk, out_path), (uint8_t *)out_buf.buf, out_buf.len)) {
+		fs_cache_forget(wk, get_cstr(wk, out_path));
 		if (!fs_write(get_cstr(wk, out_path), (uint8_t *)out_buf.buf, out_buf.len)) {
 			goto ret;
 		}
@@ -496,7 +518,10 @@ configure_file_with_command(struct workspace *wk,
 
 	join_args_argstr(wk, &argstr, &argc, args);
 	env_to_envstr(wk, &envstr, &envc, env);
-	if (!run_cmd(&cmd_ctx, argstr, argc, envstr, envc)) {
+	subproject_workers_before_command(wk);
+	bool ran = run_cmd(&cmd_ctx, argstr, argc, envstr, envc);
+	fs_cache_invalidate(wk);
+	if (!ran) {
 		vm_error_at(wk, node, "error running command: %s", cmd_ctx.err_msg);
 		goto ret;
 	}
@@ -507,9 +532,10 @@ configure_file_with_command(struct workspace *wk,
 	}
 
 	if (capture) {
-		if (file_exists_with_content(wk, get_cstr(wk, out_path), cmd_ctx.out.buf, cmd_ctx.out.len)) {
+		if (fs_file_has_content(get_cstr(wk, out_path), (uint8_t *)cmd_ctx.out.buf, cmd_ctx.out.len)) {
 			ret = true;
 		} else {
+			fs_cache_forget(wk, get_cstr(wk, out_path));
 			ret = fs_write(get_cstr(wk, out_path), (uint8_t *)cmd_ctx.out.buf, cmd_ctx.out.len);
 		}
 	} else {
@@ -733,7 +759,8 @@ func_configure_file(struct workspace *wk, obj _, obj *res)
 			return false;
 		}
 
-		if (!file_exists_with_content(wk, get_cstr(wk, output_str), src.src, src.len)) {
+		if (!fs_file_has_content(get_cstr(wk, output_str), (uint8_t *)src.src, src.len)) {
+			fs_cache_forget(wk, get_cstr(wk, output_str));
 			if (!fs_write(get_cstr(wk, output_str), (uint8_t *)src.src, src.len)) {
 				goto copy_err;
 			}
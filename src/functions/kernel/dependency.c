@@ -24,6 +24,7 @@
 #include "platform/filesystem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "time_report.h"
 
 enum dependency_lookup_method {
 	// Auto means to use whatever dependency checking mechanisms in whatever order meson thinks is best.
@@ -628,6 +629,9 @@ func_dependency(struct workspace *wk, obj self, obj *res)
 		.modules = akw[kw_modules].val,
 	};
 
+	struct timer t;
+	time_report_start(wk, &t);
+
 	if (!obj_array_foreach(wk, an[0].val, &ctx, dependency_iter)) {
 		return false;
 	}
@@ -639,6 +643,16 @@ func_dependency(struct workspace *wk, obj self, obj *res)
 		}
 	}
 
+	if (time_report_enabled(wk)) {
+		obj names;
+		obj_array_join(wk, false, an[0].val, make_str(wk, ", "), &names);
+		time_report_push(wk,
+			time_report_kind_dependency,
+			names,
+			timer_read(&t),
+			ctx.from_cache ? time_report_cached_hit : time_report_cached_miss);
+	}
+
 	if (!ctx.found) {
 		if (ctx.requirement == requirement_required) {
 			LLOG_E("required ");
@@ -5,6 +5,7 @@
 
 #include "compat.h"
 
+#include "fs_cache.h"
 #include "functions/kernel/subproject.h"
 #include "functions/string.h"
 #include "lang/typecheck.h"
@@ -12,6 +13,8 @@
 #include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
+#include "subproject_workers.h"
+#include "time_report.h"
 #include "wrap.h"
 
 static bool
@@ -30,7 +33,9 @@ subproject_prepare(struct workspace *wk,
 		SBUF(base_path);
 		sbuf_pushf(wk, &wrap_path, "%s.wrap", *cwd);
 
-		if (!fs_file_exists(wrap_path.buf)) {
+		// Subproject workers must not modify the source tree, wraps
+		// are left to the parent.
+		if (wk->subproject_workers.parent_private || !fs_file_exists(wrap_path.buf)) {
 			goto wrap_done;
 		}
 
@@ -38,7 +43,10 @@ subproject_prepare(struct workspace *wk,
 
 		struct wrap wrap = { 0 };
 		enum wrap_mode wrap_mode = get_option_wrap_mode(wk);
-		if (!wrap_handle(wrap_path.buf, base_path.buf, &wrap, wrap_mode != wrap_mode_nodownload)) {
+		bool wrap_handled = wrap_handle(wrap_path.buf, base_path.buf, &wrap, wrap_mode != wrap_mode_nodownload);
+		// The wrap may have fetched, extracted or patched files into the source tree
+		fs_cache_invalidate(wk);
+		if (!wrap_handled) {
 			goto wrap_cleanup;
 		}
 
@@ -102,6 +110,8 @@ subproject(struct workspace *wk,
 		return true;
 	}
 
+	subproject_workers_run(wk);
+
 	const char *subproj_name = get_cstr(wk, name);
 	SBUF(cwd);
 	SBUF(build_dir);
@@ -140,7 +150,12 @@ subproject(struct workspace *wk,
 		}
 	}
 
-	if (!eval_project(wk, subproj_name, sp_cwd, sp_build_dir, &subproject_id)) {
+	struct timer t;
+	time_report_start(wk, &t);
+	bool evaluated = eval_project(wk, subproj_name, sp_cwd, sp_build_dir, &subproject_id);
+	time_report_end(wk, &t, time_report_kind_subproject, name);
+
+	if (!evaluated) {
 		goto not_found;
 	}
 
@@ -10,6 +10,7 @@
 #include "args.h"
 #include "backend/common_args.h"
 #include "backend/output.h"
+#include "backend/unity.h"
 #include "coerce.h"
 #include "compilers.h"
 #include "error.h"
@@ -231,7 +232,7 @@ func_meson_is_unity(struct workspace *wk, obj _, obj *res)
 	}
 
 	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, false);
+	set_obj_bool(wk, *res, unity_enabled(wk, current_project(wk), NULL));
 	return true;
 }
 
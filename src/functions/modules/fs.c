@@ -12,6 +12,7 @@
 #include "coerce.h"
 #include "error.h"
 #include "formats/editorconfig.h"
+#include "fs_cache.h"
 #include "functions/kernel/custom_target.h"
 #include "functions/modules/fs.h"
 #include "lang/func_lookup.h"
@@ -20,7 +21,6 @@
 #include "platform/filesystem.h"
 #include "platform/os.h"
 #include "platform/path.h"
-#include "sha_256.h"
 
 enum fix_file_path_opts {
 	fix_file_path_noexpanduser = 1 << 0,
@@ -101,7 +101,7 @@ fix_file_path(struct workspace *wk, uint32_t err_node, obj path, enum fix_file_p
 	return true;
 }
 
-typedef bool((*fs_lookup_func)(const char *));
+typedef bool((*fs_lookup_func)(struct workspace *wk, const char *));
 
 static bool
 func_module_fs_lookup_common(struct workspace *wk,
@@ -126,32 +126,38 @@ func_module_fs_lookup_common(struct workspace *wk,
 	}
 
 	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, lookup(path.buf));
+	set_obj_bool(wk, *res, lookup(wk, path.buf));
 	return true;
 }
 
 static bool
 func_module_fs_exists(struct workspace *wk, obj self, obj *res)
 {
-	return func_module_fs_lookup_common(wk, res, fs_exists, 0, false);
+	return func_module_fs_lookup_common(wk, res, fs_cache_exists, 0, false);
 }
 
 static bool
 func_module_fs_is_file(struct workspace *wk, obj self, obj *res)
 {
-	return func_module_fs_lookup_common(wk, res, fs_file_exists, 0, false);
+	return func_module_fs_lookup_common(wk, res, fs_cache_file_exists, 0, false);
 }
 
 static bool
 func_module_fs_is_dir(struct workspace *wk, obj self, obj *res)
 {
-	return func_module_fs_lookup_common(wk, res, fs_dir_exists, 0, false);
+	return func_module_fs_lookup_common(wk, res, fs_cache_dir_exists, 0, false);
+}
+
+static bool
+func_module_fs_symlink_exists(struct workspace *wk, const char *path)
+{
+	return fs_symlink_exists(path);
 }
 
 static bool
 func_module_fs_is_symlink(struct workspace *wk, obj self, obj *res)
 {
-	return func_module_fs_lookup_common(wk, res, fs_symlink_exists, 0, true);
+	return func_module_fs_lookup_common(wk, res, func_module_fs_symlink_exists, 0, true);
 }
 
 static bool
@@ -355,24 +361,19 @@ func_module_fs_hash(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	struct source src = { 0 };
-	if (!fs_read_entire_file(path.buf, &src)) {
+	uint8_t hash[32] = { 0 };
+	if (!fs_sha_256_file(path.buf, hash)) { // TODO: other hash algos
 		return false;
 	}
 
-	uint8_t hash[32] = { 0 };
-	calc_sha_256(hash, src.src, src.len); // TODO: other hash algos
-
 	char buf[65] = { 0 };
 	uint32_t i, bufi = 0;
 	for (i = 0; i < 32; ++i) {
-		snprintf(&buf[bufi], 3, "%x", hash[i]);
+		snprintf(&buf[bufi], 3, "%02x", hash[i]);
 		bufi += 2;
 	}
 
 	*res = make_str(wk, buf);
-
-	fs_source_destroy(&src);
 	return true;
 }
 
@@ -390,12 +391,7 @@ func_module_fs_size(struct workspace *wk, obj self, obj *res)
 	}
 
 	uint64_t size;
-	FILE *f;
-	if (!(f = fs_fopen(path.buf, "rb"))) {
-		return false;
-	} else if (!fs_fsize(f, &size)) {
-		return false;
-	} else if (!fs_fclose(f)) {
+	if (!fs_cache_size(wk, path.buf, &size)) {
 		return false;
 	}
 
@@ -423,10 +419,8 @@ func_module_fs_is_samepath(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	// TODO: handle symlinks
-
 	make_obj(wk, res, obj_bool);
-	set_obj_bool(wk, *res, strcmp(path1.buf, path2.buf) == 0);
+	set_obj_bool(wk, *res, fs_cache_is_samepath(wk, path1.buf, path2.buf));
 	return true;
 }
 
@@ -572,6 +566,7 @@ func_module_fs_write(struct workspace *wk, obj self, obj *res)
 	}
 
 	const struct str *ss = get_str(wk, an[1].val);
+	fs_cache_forget(wk, path.buf);
 	if (!fs_write(path.buf, (uint8_t *)ss->s, ss->len)) {
 		return false;
 	}
@@ -591,7 +586,11 @@ func_module_fs_copy(struct workspace *wk, obj self, obj *res)
 		return false;
 	}
 
-	if (!fs_copy_file(path.buf, get_cstr(wk, an[1].val))) {
+	SBUF(dest);
+	path_make_absolute(wk, &dest, get_cstr(wk, an[1].val));
+	fs_cache_forget(wk, dest.buf);
+
+	if (!fs_copy_file(path.buf, dest.buf)) {
 		return false;
 	}
 	return true;
@@ -788,8 +787,8 @@ func_module_fs_glob_cb(void *_ctx, const char *name)
 			obj_array_push(wk, ctx->res, sbuf_into_str(wk, &path));
 		} else {
 			++subctx.pat;
-			if (fs_dir_exists(path.buf)) {
-				if (!fs_dir_foreach(path.buf, &subctx, func_module_fs_glob_cb)) {
+			if (fs_cache_dir_exists(wk, path.buf)) {
+				if (!fs_cache_dir_foreach(wk, path.buf, &subctx, func_module_fs_glob_cb)) {
 					return ir_err;
 				}
 			}
@@ -812,8 +811,8 @@ recurse_all_mode: {
 		obj_array_push(wk, ctx->res, sbuf_into_str(wk, &full_path));
 	}
 
-	if (fs_dir_exists(full_path.buf)) {
-		if (!fs_dir_foreach(full_path.buf, &subctx, func_module_fs_glob_cb)) {
+	if (fs_cache_dir_exists(wk, full_path.buf)) {
+		if (!fs_cache_dir_foreach(wk, full_path.buf, &subctx, func_module_fs_glob_cb)) {
 			return ir_err;
 		}
 	}
@@ -871,7 +870,7 @@ func_module_fs_glob(struct workspace *wk, obj self, obj *res)
 
 	make_obj(wk, res, obj_array);
 
-	if (!fs_dir_exists(prefix.buf)) {
+	if (!fs_cache_dir_exists(wk, prefix.buf)) {
 		return true;
 	}
 
@@ -882,7 +881,7 @@ func_module_fs_glob(struct workspace *wk, obj self, obj *res)
 		.res = *res,
 	};
 
-	return fs_dir_foreach(prefix.buf, &ctx, func_module_fs_glob_cb);
+	return fs_cache_dir_foreach(wk, prefix.buf, &ctx, func_module_fs_glob_cb);
 }
 
 struct delete_suffixes_ctx {
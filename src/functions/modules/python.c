@@ -5,22 +5,66 @@
 
 #include "compat.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "args.h"
 #include "coerce.h"
 #include "embedded.h"
 #include "external/tinyjson.h"
+#include "find_cmd_cache.h"
 #include "functions/external_program.h"
 #include "functions/modules/python.h"
 #include "install.h"
 #include "lang/object.h"
+#include "lang/object_iterators.h"
 #include "lang/typecheck.h"
 #include "options.h"
 #include "platform/filesystem.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "setup_cache.h"
+
+/*
+ * Introspecting an interpreter means starting it and importing sysconfig,
+ * which is slow compared to everything else find_installation() does.  The
+ * results are stored in the setup cache keyed by the interpreter path and
+ * validated by its mtime, so each interpreter is only introspected once per
+ * setup, and not at all on reconfigure if it hasn't changed.
+ */
+static obj
+python_introspect_cache_key(struct workspace *wk, const char *path)
+{
+	SBUF(key);
+	sbuf_pushf(wk, &key, "python:introspect\n%s\n", path);
+
+	// These change the result of introspection without touching the interpreter
+	const char *env_vars[] = { "PYTHONHOME", "PYTHONPATH", "VIRTUAL_ENV" };
+	uint32_t i;
+	for (i = 0; i < ARRAY_LEN(env_vars); ++i) {
+		const char *v = getenv(env_vars[i]);
+		sbuf_pushf(wk, &key, "%s=%s\n", env_vars[i], v ? v : "");
+	}
+
+	return make_strn(wk, key.buf, key.len);
+}
 
 static bool
 introspect_python_interpreter(struct workspace *wk, const char *path, struct obj_python_installation *python)
 {
+	obj cache_key = python_introspect_cache_key(wk, path), cached;
+	if (setup_cache_get(wk, cache_key, &cached)) {
+		obj v;
+		obj_array_index(wk, cached, 0, &python->language_version);
+		obj_array_index(wk, cached, 1, &v);
+		obj_dict_dup(wk, v, &python->sysconfig_paths);
+		obj_array_index(wk, cached, 2, &v);
+		obj_dict_dup(wk, v, &python->sysconfig_vars);
+		obj_array_index(wk, cached, 3, &v);
+		obj_dict_dup(wk, v, &python->install_paths);
+		return true;
+	}
+
 	const char *pyinfo = embedded_get("python_info.py");
 	if (!pyinfo) {
 		return false;
@@ -58,49 +102,75 @@ introspect_python_interpreter(struct workspace *wk, const char *path, struct obj
 		success = false;
 		goto end;
 	}
+
+	make_obj(wk, &cached, obj_array);
+	obj_array_push(wk, cached, python->language_version);
+	obj_array_push(wk, cached, python->sysconfig_paths);
+	obj_array_push(wk, cached, python->sysconfig_vars);
+	obj_array_push(wk, cached, python->install_paths);
+
+	obj files;
+	make_obj(wk, &files, obj_array);
+	obj_array_push(wk, files, make_str(wk, path));
+	setup_cache_set(wk, cache_key, files, cached);
 end:
 	run_cmd_ctx_destroy(&cmd_ctx);
 	return success;
 }
 
+/*
+ * Checks all modules with a single interpreter launch.  The script prints the
+ * name of every module that failed to import, one per line.
+ */
 static bool
-python_module_present(struct workspace *wk, const char *pythonpath, const char *mod)
+python_modules_missing(struct workspace *wk, const char *pythonpath, obj modules, obj *missing)
 {
-	struct run_cmd_ctx cmd_ctx = { 0 };
-
-	SBUF(importstr);
-	sbuf_pushf(wk, &importstr, "import %s", mod);
-
-	char *const *args = (char *const[]){ (char *)pythonpath, "-c", importstr.buf, 0 };
+	static const char *script = "import sys\n"
+				    "for m in sys.argv[1:]:\n"
+				    "    try:\n"
+				    "        __import__(m)\n"
+				    "    except Exception:\n"
+				    "        print(m)\n";
+
+	make_obj(wk, missing, obj_dict);
+
+	obj args;
+	make_obj(wk, &args, obj_array);
+	obj_array_push(wk, args, make_str(wk, pythonpath));
+	obj_array_push(wk, args, make_str(wk, "-c"));
+	obj_array_push(wk, args, make_str(wk, script));
+	obj_array_extend(wk, args, modules);
+
+	const char *argstr;
+	uint32_t argc;
+	join_args_argstr(wk, &argstr, &argc, args);
 
-	bool present = run_cmd_argv(&cmd_ctx, args, NULL, 0) && cmd_ctx.status == 0;
-
-	run_cmd_ctx_destroy(&cmd_ctx);
-
-	return present;
-}
+	struct run_cmd_ctx cmd_ctx = { 0 };
+	bool ok = run_cmd(&cmd_ctx, argstr, argc, NULL, 0) && cmd_ctx.status == 0;
 
-struct iter_mod_ctx {
-	const char *pythonpath;
-	uint32_t node;
-	enum requirement_type requirement;
-};
+	if (ok) {
+		const char *p = cmd_ctx.out.buf, *nl;
+		while (*p) {
+			if (!(nl = strchr(p, '\n'))) {
+				nl = p + strlen(p);
+			}
 
-static enum iteration_result
-iterate_required_module_list(struct workspace *wk, void *ctx, obj val)
-{
-	struct iter_mod_ctx *_ctx = ctx;
-	const char *mod = get_cstr(wk, val);
+			uint32_t len = nl - p;
+			if (len && p[len - 1] == '\r') {
+				--len;
+			}
 
-	if (python_module_present(wk, _ctx->pythonpath, mod)) {
-		return ir_cont;
-	}
+			if (len) {
+				obj m = make_strn(wk, p, len);
+				obj_dict_set(wk, *missing, m, m);
+			}
 
-	if (_ctx->requirement == requirement_required) {
-		vm_error_at(wk, _ctx->node, "python: required module '%s' not found", mod);
+			p = *nl ? nl + 1 : nl;
+		}
 	}
 
-	return ir_err;
+	run_cmd_ctx_destroy(&cmd_ctx);
+	return ok;
 }
 
 static bool
@@ -163,7 +233,7 @@ func_module_python_find_installation(struct workspace *wk, obj self, obj *res)
 	}
 
 	SBUF(cmd_path);
-	bool found = fs_find_cmd(wk, &cmd_path, cmd);
+	bool found = find_cmd_cached(wk, &cmd_path, cmd);
 	if (!found && (requirement == requirement_required)) {
 		vm_error(wk, "%s not found", cmd);
 		return false;
@@ -179,14 +249,27 @@ func_module_python_find_installation(struct workspace *wk, obj self, obj *res)
 	}
 
 	if (akw[kw_modules].set && found) {
-		bool all_present = obj_array_foreach(wk,
-			akw[kw_modules].val,
-			&(struct iter_mod_ctx){
-				.pythonpath = cmd_path.buf,
-				.node = akw[kw_modules].node,
-				.requirement = requirement,
-			},
-			iterate_required_module_list);
+		obj missing, mod;
+		bool all_present = true;
+		if (!python_modules_missing(wk, cmd_path.buf, akw[kw_modules].val, &missing)) {
+			all_present = false;
+			if (requirement == requirement_required) {
+				vm_error_at(wk, akw[kw_modules].node, "python: failed to check for required modules");
+			}
+		} else {
+			obj_array_for(wk, akw[kw_modules].val, mod) {
+				if (obj_dict_in(wk, missing, mod)) {
+					if (requirement == requirement_required) {
+						vm_error_at(wk,
+							akw[kw_modules].node,
+							"python: required module '%s' not found",
+							get_cstr(wk, mod));
+					}
+					all_present = false;
+					break;
+				}
+			}
+		}
 
 		if (!all_present) {
 			if (requirement == requirement_required) {
@@ -229,7 +312,7 @@ func_module_python3_find_python(struct workspace *wk, obj self, obj *res)
 	}
 
 	SBUF(cmd_path);
-	if (!fs_find_cmd(wk, &cmd_path, cmd)) {
+	if (!find_cmd_cached(wk, &cmd_path, cmd)) {
 		vm_error(wk, "python3 not found");
 		return false;
 	}
@@ -99,9 +99,6 @@ eval(struct workspace *wk, struct source *src, enum eval_mode mode, obj *res)
 {
 	TracyCZoneAutoS;
 
-	arr_push(&wk->vm.src, src);
-	src = arr_peek(&wk->vm.src, 1);
-
 	enum vm_compile_mode compile_mode
 		= (wk->vm.lang_mode == language_extended || wk->vm.lang_mode == language_internal) ?
 			  vm_compile_mode_language_extended :
@@ -111,8 +108,20 @@ eval(struct workspace *wk, struct source *src, enum eval_mode mode, obj *res)
 		compile_mode |= vm_compile_mode_expr;
 	}
 
+	// The analyzer instruments compiled code per evaluation, so it never
+	// reuses it.
+	obj code_cache_key = 0, cached_entry;
+	if ((mode & eval_mode_cache_code) && !wk->vm.in_analyzer) {
+		code_cache_key = make_strf(wk, "%d:%s", wk->vm.lang_mode, src->label);
+	}
+
 	uint32_t entry;
-	{
+	if (code_cache_key && obj_dict_index(wk, wk->vm.code_cache, code_cache_key, &cached_entry)) {
+		entry = get_obj_number(wk, cached_entry);
+	} else {
+		arr_push(&wk->vm.src, src);
+		src = arr_peek(&wk->vm.src, 1);
+
 		struct node *n;
 
 		vm_compile_state_reset(wk);
@@ -130,6 +139,10 @@ eval(struct workspace *wk, struct source *src, enum eval_mode mode, obj *res)
 		if (!vm_compile_ast(wk, n, compile_mode, &entry)) {
 			return false;
 		}
+
+		if (code_cache_key) {
+			obj_dict_set(wk, wk->vm.code_cache, code_cache_key, make_number(wk, entry));
+		}
 	}
 
 	if (wk->vm.dbg_state.eval_trace) {
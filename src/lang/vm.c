@@ -2605,6 +2605,8 @@ vm_init(struct workspace *wk)
 
 	wk->vm.scope_stack = wk->vm.behavior.scope_stack_dup(wk, wk->vm.default_scope_stack);
 
+	make_obj(wk, &wk->vm.code_cache, obj_dict);
+
 	/* initial code segment */
 	vm_compile_initial_code_segment(wk);
 }
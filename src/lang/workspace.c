@@ -93,7 +93,7 @@ workspace_eval_startup_file(struct workspace *wk, const char *script)
 	stack_push(&wk->stack, wk->vm.lang_mode, language_extended);
 	stack_push(&wk->stack, wk->vm.scope_stack, wk->vm.behavior.scope_stack_dup(wk, wk->vm.default_scope_stack));
 
-	ret = eval(wk, &(struct source){ .src = src, .label = script, .len = strlen(src) }, eval_mode_default, &_);
+	ret = eval(wk, &(struct source){ .src = src, .label = script, .len = strlen(src) }, eval_mode_cache_code, &_);
 
 	stack_pop(&wk->stack, wk->vm.scope_stack);
 	stack_pop(&wk->stack, wk->vm.lang_mode);
@@ -130,6 +130,14 @@ workspace_init_runtime(struct workspace *wk)
 	make_obj(wk, &wk->global_opts, obj_dict);
 	make_obj(wk, &wk->compiler_check_cache, obj_dict);
 	make_obj(wk, &wk->dependency_handlers, obj_dict);
+	make_obj(wk, &wk->find_cmd_cache.prev_dirs, obj_dict);
+	make_obj(wk, &wk->find_cmd_cache.dirs, obj_dict);
+	make_obj(wk, &wk->find_cmd_cache.results, obj_dict);
+	make_obj(wk, &wk->setup_cache.prev, obj_dict);
+	make_obj(wk, &wk->setup_cache.cur, obj_dict);
+	make_obj(wk, &wk->fs_cache.stat, obj_dict);
+	make_obj(wk, &wk->fs_cache.stat_res, obj_dict);
+	make_obj(wk, &wk->fs_cache.dirs, obj_dict);
 }
 
 void
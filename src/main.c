@@ -20,6 +20,7 @@
 #include "external/libcurl.h"
 #include "external/libpkgconf.h"
 #include "external/samurai.h"
+#include "find_cmd_cache.h"
 #include "lang/analyze.h"
 #include "lang/compiler.h"
 #include "lang/fmt.h"
@@ -29,10 +30,16 @@
 #include "meson_opts.h"
 #include "options.h"
 #include "opts.h"
+#include "platform/filesystem.h"
 #include "platform/init.h"
 #include "platform/mem.h"
+#include "platform/os.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "platform/timer.h"
+#include "regenerate_deps.h"
+#include "setup_cache.h"
+#include "time_report.h"
 #include "tracy.h"
 #include "version.h"
 #include "vsenv.h"
@@ -451,80 +458,281 @@ ret:
 	return ret;
 }
 
+/*
+ * Subprojects are downloaded either in-process, one at a time, or, when more
+ * than one job is requested, by running `muon subprojects download <name>`
+ * for each wrap in a pool of child processes.  The output of each child is
+ * captured and only shown if it fails.
+ */
+struct cmd_subprojects_download_job {
+	struct run_cmd_ctx cmd_ctx;
+	const char *name;
+	bool busy;
+};
+
 struct cmd_subprojects_download_ctx {
+	const char *argv0;
 	const char *subprojects;
+	uint32_t jobs;
+	bool offline;
+
+	struct sbuf *names; // NUL delimited list of wrap names
+	uint32_t names_len;
+
+	struct cmd_subprojects_download_job *job_slots;
+	uint32_t busy, done;
+
+	struct sbuf *failed; // report of failed wraps
+	uint32_t failed_len;
 };
 
 static enum iteration_result
-cmd_subprojects_download_iter(void *_ctx, const char *name)
+cmd_subprojects_download_collect_iter(void *_ctx, const char *name)
 {
 	struct cmd_subprojects_download_ctx *ctx = _ctx;
 	uint32_t len = strlen(name);
-	SBUF_manual(path);
 
 	if (len <= 5 || strcmp(&name[len - 5], ".wrap") != 0) {
-		goto cont;
+		return ir_cont;
 	}
 
+	sbuf_pushn(NULL, ctx->names, name, len - 5);
+	sbuf_push(NULL, ctx->names, 0);
+	++ctx->names_len;
+	return ir_cont;
+}
+
+static void
+cmd_subprojects_download_push_failed(struct cmd_subprojects_download_ctx *ctx, const char *name)
+{
+	++ctx->failed_len;
+	sbuf_pushf(NULL, ctx->failed, "  %s\n", name);
+}
+
+static void
+cmd_subprojects_download_push_output(struct cmd_subprojects_download_ctx *ctx, const char *s, uint32_t len)
+{
+	uint32_t i;
+	bool bol = true;
+	for (i = 0; i < len; ++i) {
+		if (bol) {
+			sbuf_pushs(NULL, ctx->failed, "    ");
+		}
+
+		sbuf_push(NULL, ctx->failed, s[i]);
+		bol = s[i] == '\n';
+	}
+
+	if (!bol) {
+		sbuf_push(NULL, ctx->failed, '\n');
+	}
+}
+
+static bool
+cmd_subprojects_download_one(struct cmd_subprojects_download_ctx *ctx, const char *name)
+{
+	bool res = false;
+	SBUF_manual(path);
+
 	path_join(NULL, &path, ctx->subprojects, name);
+	sbuf_pushs(NULL, &path, ".wrap");
 
 	if (!fs_file_exists(path.buf)) {
-		goto cont;
+		LOG_E("wrap file for '%s' not found", name);
+		goto ret;
 	}
 
 	LOG_I("fetching %s", name);
 	struct wrap wrap = { 0 };
-	if (!wrap_handle(path.buf, ctx->subprojects, &wrap, true)) {
-		goto cont;
+	if (!wrap_handle(path.buf, ctx->subprojects, &wrap, !ctx->offline)) {
+		goto ret;
 	}
 
 	wrap_destroy(&wrap);
-cont:
+	res = true;
+ret:
 	sbuf_destroy(&path);
-	return ir_cont;
+	return res;
+}
+
+static void
+cmd_subprojects_download_collect(struct cmd_subprojects_download_ctx *ctx)
+{
+	uint32_t i;
+	for (i = 0; i < ctx->jobs; ++i) {
+		struct cmd_subprojects_download_job *job = &ctx->job_slots[i];
+
+		if (!job->busy) {
+			continue;
+		}
+
+		bool ok;
+		switch (run_cmd_collect(&job->cmd_ctx)) {
+		case run_cmd_running: continue;
+		case run_cmd_error: ok = false; break;
+		case run_cmd_finished: ok = job->cmd_ctx.status == 0; break;
+		default: UNREACHABLE;
+		}
+
+		++ctx->done;
+		if (ok) {
+			LOG_I("[%d/%d] fetched %s", ctx->done, ctx->names_len, job->name);
+		} else {
+			LOG_E("[%d/%d] failed to fetch %s", ctx->done, ctx->names_len, job->name);
+
+			cmd_subprojects_download_push_failed(ctx, job->name);
+			if (job->cmd_ctx.err_msg) {
+				cmd_subprojects_download_push_output(ctx, job->cmd_ctx.err_msg, strlen(job->cmd_ctx.err_msg));
+			}
+			cmd_subprojects_download_push_output(ctx, job->cmd_ctx.out.buf, job->cmd_ctx.out.len);
+			cmd_subprojects_download_push_output(ctx, job->cmd_ctx.err.buf, job->cmd_ctx.err.len);
+		}
+
+		run_cmd_ctx_destroy(&job->cmd_ctx);
+		*job = (struct cmd_subprojects_download_job){ 0 };
+		--ctx->busy;
+	}
+}
+
+static void
+cmd_subprojects_download_push(struct cmd_subprojects_download_ctx *ctx, const char *name)
+{
+	uint32_t i;
+	while (true) {
+		for (i = 0; i < ctx->jobs; ++i) {
+			if (!ctx->job_slots[i].busy) {
+				goto found_slot;
+			}
+		}
+
+		timer_sleep(10000000); // 10ms
+		cmd_subprojects_download_collect(ctx);
+	}
+found_slot:
+	++ctx->busy;
+
+	struct cmd_subprojects_download_job *job = &ctx->job_slots[i];
+	*job = (struct cmd_subprojects_download_job){
+		.busy = true,
+		.name = name,
+		.cmd_ctx = { .flags = run_cmd_ctx_flag_async },
+	};
+
+	uint32_t child_argc = 0;
+	char *child_argv[8];
+	child_argv[child_argc++] = (char *)ctx->argv0;
+	child_argv[child_argc++] = "subprojects";
+	child_argv[child_argc++] = "-d";
+	child_argv[child_argc++] = (char *)ctx->subprojects;
+	child_argv[child_argc++] = "download";
+	if (ctx->offline) {
+		child_argv[child_argc++] = "-o";
+	}
+	child_argv[child_argc++] = (char *)name;
+	child_argv[child_argc++] = NULL;
+
+	if (!run_cmd_argv(&job->cmd_ctx, child_argv, NULL, 0)) {
+		++ctx->done;
+		LOG_E("[%d/%d] failed to fetch %s", ctx->done, ctx->names_len, name);
+		cmd_subprojects_download_push_failed(ctx, name);
+		if (job->cmd_ctx.err_msg) {
+			cmd_subprojects_download_push_output(ctx, job->cmd_ctx.err_msg, strlen(job->cmd_ctx.err_msg));
+		}
+
+		run_cmd_ctx_destroy(&job->cmd_ctx);
+		*job = (struct cmd_subprojects_download_job){ 0 };
+		--ctx->busy;
+	}
 }
 
 static bool
 cmd_subprojects_download(uint32_t argc, uint32_t argi, char *const argv[])
 {
-	bool res = false;
+	bool res = false, offline = false;
+	uint32_t jobs = os_parallel_job_count();
 
-	OPTSTART("") {
+	OPTSTART("j:o") {
+	case 'j': {
+		char *endptr;
+		unsigned long n = strtoul(optarg, &endptr, 10);
+
+		if (!n || n > UINT32_MAX || !*optarg || *endptr) {
+			LOG_E("invalid number of jobs: %s", optarg);
+			return false;
+		}
+
+		jobs = n;
+		break;
 	}
-	OPTEND(argv[argi], " <list of subprojects>", "", NULL, -1)
+	case 'o': offline = true; break;
+	}
+	OPTEND(argv[argi],
+		" <list of subprojects>",
+		"  -j <jobs> - set the number of subprojects to download in parallel\n"
+		"  -o - offline mode; only use local files and the wrap cache\n",
+		NULL,
+		-1)
 
 	SBUF_manual(path);
+	SBUF_manual(names);
+	SBUF_manual(failed);
 	path_make_absolute(NULL, &path, cmd_subprojects_subprojects_dir);
 
 	struct cmd_subprojects_download_ctx ctx = {
+		.argv0 = argv[0],
 		.subprojects = path.buf,
+		.offline = offline,
+		.names = &names,
+		.failed = &failed,
 	};
 
 	if (argc > argi) {
-		SBUF_manual(wrap_file);
-
 		for (; argc > argi; ++argi) {
-			path_join(NULL, &wrap_file, ctx.subprojects, argv[argi]);
+			sbuf_pushs(NULL, &names, argv[argi]);
+			sbuf_push(NULL, &names, 0);
+			++ctx.names_len;
+		}
+	} else if (!fs_dir_foreach(path.buf, &ctx, cmd_subprojects_download_collect_iter)) {
+		goto ret;
+	}
 
-			sbuf_pushs(NULL, &wrap_file, ".wrap");
+	ctx.jobs = jobs < ctx.names_len ? jobs : ctx.names_len;
 
-			if (!fs_file_exists(wrap_file.buf)) {
-				LOG_E("wrap file for '%s' not found", argv[argi]);
-				goto ret;
+	uint32_t i;
+	const char *name = names.buf;
+	if (ctx.jobs <= 1) {
+		for (i = 0; i < ctx.names_len; ++i, name += strlen(name) + 1) {
+			if (!cmd_subprojects_download_one(&ctx, name)) {
+				cmd_subprojects_download_push_failed(&ctx, name);
 			}
+		}
+	} else {
+		ctx.job_slots = z_calloc(ctx.jobs, sizeof(struct cmd_subprojects_download_job));
 
-			if (cmd_subprojects_download_iter(&ctx, wrap_file.buf) == ir_err) {
-				goto ret;
-			}
+		for (i = 0; i < ctx.names_len; ++i, name += strlen(name) + 1) {
+			cmd_subprojects_download_push(&ctx, name);
 		}
 
-		sbuf_destroy(&wrap_file);
-		res = true;
-	} else {
-		res = fs_dir_foreach(path.buf, &ctx, cmd_subprojects_download_iter);
+		while (ctx.busy) {
+			timer_sleep(10000000); // 10ms
+			cmd_subprojects_download_collect(&ctx);
+		}
+
+		z_free(ctx.job_slots);
+	}
+
+	if (ctx.failed_len) {
+		if (ctx.names_len > 1) {
+			LOG_E("failed to fetch %d of %d subprojects:", ctx.failed_len, ctx.names_len);
+			log_plain("%s", failed.buf);
+		}
+		goto ret;
 	}
 
+	res = true;
 ret:
+	sbuf_destroy(&failed);
+	sbuf_destroy(&names);
 	sbuf_destroy(&path);
 	return res;
 }
@@ -819,8 +1027,9 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 	workspace_init_runtime(&wk);
 
 	uint32_t original_argi = argi + 1;
+	bool time_report_json = false, regenerate = false, loaded_check_cache = false;
 
-	OPTSTART("D:c:b:") {
+	OPTSTART("D:c:b:t:rj:") {
 	case 'D':
 		if (!parse_and_set_cmdline_option(&wk, optarg)) {
 			goto ret;
@@ -836,28 +1045,87 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 		} else if (!fs_fclose(f)) {
 			goto ret;
 		}
+		loaded_check_cache = true;
 		break;
 	}
 	case 'b': {
 		vm_dbg_push_breakpoint(&wk, optarg);
 		break;
 	}
+	case 't': {
+		if (strcmp(optarg, "term") == 0) {
+			time_report_json = false;
+		} else if (strcmp(optarg, "json") == 0) {
+			time_report_json = true;
+		} else {
+			LOG_E("invalid time report mode '%s'", optarg);
+			goto ret;
+		}
+
+		make_obj(&wk, &wk.time_report, obj_array);
+		break;
+	}
+	case 'r': {
+		regenerate = true;
+		break;
+	}
+	case 'j': {
+		char *endptr;
+		unsigned long n = strtoul(optarg, &endptr, 10);
+
+		if (!n || n > UINT32_MAX || !*optarg || *endptr) {
+			LOG_E("invalid number of jobs: %s", optarg);
+			goto ret;
+		}
+
+		wk.subproject_workers.jobs = n;
+		break;
+	}
 	}
 	OPTEND(argv[argi],
 		" <build dir>",
 		"  -D <option>=<value> - set project options\n"
 		"  -c <compiler_check_cache.dat> - path to compiler check cache dump\n"
-		"  -b <breakpoint> - set breakpoint\n",
+		"  -b <breakpoint> - set breakpoint\n"
+		"  -t <mode> - report time spent during setup (term|json)\n"
+		"  -r - skip setup if no regeneration dependency has changed\n"
+		"  -j <jobs> - evaluate subprojects in parallel using up to <jobs> workers\n",
 		NULL,
 		1)
 
 	const char *build = argv[argi];
 	++argi;
 
+	// When regenerating, compiler checks are already answered by the
+	// previous setup's cache and subproject workers would only add overhead.
+	if (loaded_check_cache) {
+		wk.subproject_workers.jobs = 0;
+	}
+
 	if (!workspace_setup_paths(&wk, build, argv[0], argc - original_argi, &argv[original_argi])) {
 		goto ret;
 	}
 
+	if (regenerate && regenerate_deps_unchanged(&wk)) {
+		// Only refresh build.ninja's mtime so the regenerate rule is
+		// considered up to date again.
+		SBUF(build_ninja);
+		path_join(&wk, &build_ninja, wk.build_root, "build.ninja");
+		if (fs_touch(build_ninja.buf)) {
+			LOG_I("regeneration dependencies unchanged, skipping setup");
+			res = true;
+			goto ret;
+		}
+	}
+
+	if (!find_cmd_cache_load(&wk)) {
+		LOG_W("failed to load find_program cache");
+	}
+
+	if (!setup_cache_load(&wk)) {
+		LOG_W("failed to load setup cache");
+	}
+
 	workspace_init_startup_files(&wk);
 
 	uint32_t project_id;
@@ -873,6 +1141,16 @@ cmd_setup(uint32_t argc, uint32_t argi, char *const argv[])
 
 	workspace_print_summaries(&wk, log_file());
 
+	if (time_report_json) {
+		if (!with_open(wk.muon_private, output_path.time_report, &wk, NULL, time_report_dump_json)) {
+			goto ret;
+		}
+
+		LOG_I("wrote time report to %s/%s", wk.muon_private, output_path.time_report);
+	} else {
+		time_report_print(&wk, log_file());
+	}
+
 	LOG_I("setup complete");
 
 	res = true;
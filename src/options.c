@@ -668,7 +668,7 @@ init_builtin_options(struct workspace *wk, const char *script, const char *fallb
 	wk->vm.lang_mode = language_opts;
 	obj _;
 	initializing_builtin_options = true;
-	bool ret = eval_str_label(wk, script, opts, eval_mode_default, &_);
+	bool ret = eval_str_label(wk, script, opts, eval_mode_cache_code, &_);
 	initializing_builtin_options = false;
 	wk->vm.lang_mode = old_mode;
 	return ret;
@@ -834,6 +834,7 @@ init_global_options(struct workspace *wk)
 	set_binary_from_env(wk, "OBJC", "env.OBJC");
 	set_binary_from_env(wk, "OBJCPP", "env.OBJCPP");
 	set_binary_from_env(wk, "NASM", "env.NASM");
+	set_binary_from_env(wk, "DWP", "env.DWP");
 	set_compile_opt_from_env(wk, "cpp_args", "CXXFLAGS", "CPPFLAGS");
 	set_compile_opt_from_env(wk, "cpp_link_args", "CXXFLAGS", "LDFLAGS");
 	set_str_opt_from_env(wk, "PKG_CONFIG_PATH", "pkg_config_path");
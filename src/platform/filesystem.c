@@ -35,6 +35,9 @@
 #include "platform/mem.h"
 #include "platform/os.h" // For S_ISDIR, S_ISREG on windows
 #include "platform/path.h"
+#include "sha_256.h"
+
+#define FS_MMAP_MIN_SIZE BUF_SIZE_32k
 
 bool
 fs_stat(const char *path, struct stat *sb)
@@ -168,13 +171,14 @@ fs_is_seekable(FILE *file, bool *res)
 	return true;
 }
 
-bool
-fs_read_entire_file(const char *path, struct source *src)
+static bool
+fs_read_entire_file_impl(const char *path, struct source *src, bool map)
 {
 	FILE *f;
 	bool opened = false;
 	size_t read;
 	char *buf = NULL;
+	const char *mapped = NULL;
 
 	*src = (struct source){ .label = path, .reopen_type = source_reopen_type_file };
 
@@ -207,14 +211,18 @@ fs_read_entire_file(const char *path, struct source *src)
 			goto err;
 		}
 
-		buf = z_calloc(src->len + 1, 1);
-		read = fread(buf, 1, src->len, f);
-
-		if (read != src->len) {
-			LOG_E("failed to read entire file, only read %" PRIu64 "/%" PRId64 "bytes",
-				(uint64_t)read,
-				src->len);
-			goto err;
+		// Large files are mapped rather than copied.  Smaller ones are
+		// cheaper to read.
+		if (!map || src->len < FS_MMAP_MIN_SIZE || !fs_mmap(f, src->len, &mapped)) {
+			buf = z_calloc(src->len + 1, 1);
+			read = fread(buf, 1, src->len, f);
+
+			if (read != src->len) {
+				LOG_E("failed to read entire file, only read %" PRIu64 "/%" PRId64 "bytes",
+					(uint64_t)read,
+					src->len);
+				goto err;
+			}
 		}
 	} else {
 		uint32_t buf_size = BUF_SIZE_4k;
@@ -244,7 +252,12 @@ fs_read_entire_file(const char *path, struct source *src)
 		}
 	}
 
-	src->src = buf;
+	if (mapped) {
+		src->src = mapped;
+		src->mapped = true;
+	} else {
+		src->src = buf;
+	}
 	return true;
 err:
 	if (opened) {
@@ -254,9 +267,31 @@ err:
 	if (buf) {
 		z_free(buf);
 	}
+
+	if (mapped) {
+		fs_munmap(mapped, src->len);
+	}
 	return false;
 }
 
+bool
+fs_read_entire_file(const char *path, struct source *src)
+{
+	return fs_read_entire_file_impl(path, src, false);
+}
+
+/*
+ * Reading a mapped file after it has been truncated raises SIGBUS, so this is
+ * only used for files that muon itself writes and that nothing else modifies
+ * while they are being read: the ninja manifest, log and deps files read by
+ * samurai.
+ */
+bool
+fs_read_entire_file_mapped(const char *path, struct source *src)
+{
+	return fs_read_entire_file_impl(path, src, true);
+}
+
 void
 fs_source_dup(const struct source *src, struct source *dup)
 {
@@ -266,6 +301,7 @@ fs_source_dup(const struct source *src, struct source *dup)
 	dup->src = buf;
 	dup->len = src->len;
 	dup->reopen_type = src->reopen_type;
+	dup->mapped = false;
 
 	memcpy(buf, src->src, src->len);
 	memcpy(&buf[src->len], src->label, label_len);
@@ -274,11 +310,14 @@ fs_source_dup(const struct source *src, struct source *dup)
 void
 fs_source_destroy(struct source *src)
 {
-	if (src->src) {
+	if (src->mapped) {
+		fs_munmap(src->src, src->len);
+	} else if (src->src) {
 		z_free((char *)src->src);
 	}
 	src->src = 0;
 	src->len = 0;
+	src->mapped = false;
 }
 
 bool
@@ -354,6 +393,118 @@ fs_write(const char *path, const uint8_t *buf, uint64_t buf_len)
 	return true;
 }
 
+/*
+ * Most of the time a generated file is unchanged, so rather than reading the
+ * existing file into memory, compare it a chunk at a time and stop at the
+ * first difference, or before reading anything if the sizes differ.
+ */
+bool
+fs_file_has_content(const char *path, const uint8_t *buf, uint64_t buf_len)
+{
+	if (!fs_file_exists(path)) {
+		return false;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path, "rb"))) {
+		return false;
+	}
+
+	uint64_t size;
+	bool eql = fs_fsize(f, &size) && size == buf_len;
+
+	uint8_t chunk[BUF_SIZE_32k];
+	uint64_t off = 0;
+	size_t read;
+	while (eql && (read = fread(chunk, 1, sizeof(chunk), f))) {
+		eql = read <= buf_len - off && memcmp(chunk, &buf[off], read) == 0;
+		off += read;
+	}
+
+	eql = eql && off == buf_len && !ferror(f);
+
+	if (!fs_fclose(f)) {
+		return false;
+	}
+
+	return eql;
+}
+
+/*
+ * Compares two files chunk by chunk, stopping at the first difference.
+ */
+bool
+fs_files_equal(const char *a, const char *b)
+{
+	if (!fs_file_exists(a) || !fs_file_exists(b)) {
+		return false;
+	}
+
+	FILE *fa, *fb;
+	if (!(fa = fs_fopen(a, "rb"))) {
+		return false;
+	} else if (!(fb = fs_fopen(b, "rb"))) {
+		fs_fclose(fa);
+		return false;
+	}
+
+	uint64_t size_a, size_b;
+	bool eql = fs_fsize(fa, &size_a) && fs_fsize(fb, &size_b) && size_a == size_b;
+
+	uint8_t chunk_a[BUF_SIZE_4k], chunk_b[BUF_SIZE_4k];
+	size_t read;
+	while (eql && (read = fread(chunk_a, 1, sizeof(chunk_a), fa))) {
+		eql = fread(chunk_b, 1, read, fb) == read && memcmp(chunk_a, chunk_b, read) == 0;
+	}
+
+	eql = eql && !ferror(fa) && !ferror(fb);
+
+	bool closed = fs_fclose(fa);
+	closed = fs_fclose(fb) && closed;
+	return closed && eql;
+}
+
+/*
+ * Hashes a file without reading it into memory all at once.
+ */
+bool
+fs_sha_256_file(const char *path, uint8_t hash[SHA_256_HASH_SIZE])
+{
+	FILE *f;
+	bool res = true;
+	size_t read;
+	uint8_t buf[BUF_SIZE_32k];
+	struct sha_256 sha_256;
+
+	if (!fs_file_exists(path)) {
+		LOG_E("'%s' is not a file", path);
+		return false;
+	}
+
+	if (!(f = fs_fopen(path, "rb"))) {
+		return false;
+	}
+
+	sha_256_init(&sha_256, hash);
+
+	while ((read = fread(buf, 1, sizeof(buf), f))) {
+		sha_256_write(&sha_256, buf, read);
+	}
+
+	if (ferror(f)) {
+		LOG_E("failed to read '%s'", path);
+		res = false;
+	}
+
+	sha_256_close(&sha_256);
+
+	if (!fs_fclose(f)) {
+		res = false;
+	}
+
+	return res;
+}
+
 bool
 fs_has_cmd(const char *cmd)
 {
@@ -393,11 +544,13 @@ fs_copy_dir_iter(void *_ctx, const char *path)
 	path_join(NULL, &src, ctx->src_base, path);
 	path_join(NULL, &dest, ctx->dest_base, path);
 
-	if (!fs_stat(src.buf, &sb)) {
+	if (fs_symlink_exists(src.buf)) {
+		if (!fs_copy_file(src.buf, dest.buf)) {
+			goto ret;
+		}
+	} else if (!fs_stat(src.buf, &sb)) {
 		goto ret;
-	}
-
-	if (S_ISDIR(sb.st_mode)) {
+	} else if (S_ISDIR(sb.st_mode)) {
 		if (!fs_mkdir(dest.buf, true)) {
 			goto ret;
 		}
@@ -10,9 +10,15 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
 #include "buf_size.h"
 #include "lang/string.h"
 #include "log.h"
@@ -59,6 +65,28 @@ fs_mtime(const char *path, int64_t *mtime)
 	}
 }
 
+bool
+fs_rename(const char *src, const char *dest)
+{
+	if (rename(src, dest) == -1) {
+		LOG_E("failed rename(%s, %s): %s", src, dest, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+fs_touch(const char *path)
+{
+	if (utimensat(AT_FDCWD, path, NULL, 0) == -1) {
+		LOG_E("failed utimensat(AT_FDCWD, %s, NULL, 0): %s", path, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
 bool
 fs_exists(const char *path)
 {
@@ -218,6 +246,14 @@ fs_copy_file(const char *src, const char *dest)
 
 	assert(f_dest != 0);
 
+#ifdef FICLONE
+	// Share the source's data blocks on filesystems that support it
+	if (ioctl(f_dest, FICLONE, fileno(f_src)) == 0) {
+		res = true;
+		goto ret;
+	}
+#endif
+
 	size_t r;
 	ssize_t w;
 	char buf[BUF_SIZE_32k];
@@ -445,3 +481,43 @@ fs_make_tmp_file(const char *name, const char *suffix, char *buf, uint32_t len)
 {
 	return 0;
 }
+
+bool
+fs_mmap(FILE *f, uint64_t len, const char **res)
+{
+	static long page_size;
+	if (!page_size && (page_size = sysconf(_SC_PAGESIZE)) <= 0) {
+		page_size = -1;
+	}
+
+	// The terminating zero comes from the zero filled remainder of the last
+	// page, which doesn't exist if the file ends on a page boundary.
+	if (page_size <= 0 || !len || len % page_size == 0 || len >= SIZE_MAX) {
+		return false;
+	}
+
+	int fd;
+	if (!fs_fileno(f, &fd)) {
+		return false;
+	}
+
+	char *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+
+	// If the file grew after its size was read, p[len] is file data rather
+	// than padding.  The mapping is private, so it can simply be cleared.
+	if (p[len]) {
+		p[len] = 0;
+	}
+
+	*res = p;
+	return true;
+}
+
+void
+fs_munmap(const char *p, uint64_t len)
+{
+	munmap((void *)p, len);
+}
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #if defined(__APPLE__) && defined(MUON_BOOTSTRAPPED)
@@ -71,3 +72,45 @@ os_set_env(const struct str *k, const struct str *v)
 
 	setenv(buf_k.buf, buf_v.buf, true);
 }
+
+uint32_t
+os_getpid(void)
+{
+	return getpid();
+}
+
+bool
+os_fork(uint32_t *pid)
+{
+	pid_t res;
+	if ((res = fork()) == -1) {
+		LOG_E("failed fork(): %s", strerror(errno));
+		return false;
+	}
+
+	*pid = res;
+	return true;
+}
+
+bool
+os_wait_child(uint32_t *pid, int32_t *status)
+{
+	pid_t res;
+	int st;
+	while ((res = waitpid(-1, &st, 0)) == -1) {
+		if (errno != EINTR) {
+			LOG_E("failed waitpid(): %s", strerror(errno));
+			return false;
+		}
+	}
+
+	*pid = res;
+	*status = WIFEXITED(st) ? WEXITSTATUS(st) : -1;
+	return true;
+}
+
+void
+os_exit_child(int32_t status)
+{
+	_exit(status);
+}
@@ -532,6 +532,34 @@ fs_mtime(const char *path, int64_t *mtime)
 	return fs_mtime_result_ok;
 }
 
+bool
+fs_touch(const char *path)
+{
+	HANDLE h = CreateFile(path,
+		FILE_WRITE_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL);
+	if (h == INVALID_HANDLE_VALUE) {
+		LOG_E("failed CreateFile(\"%s\"): %s", path, win32_error());
+		return false;
+	}
+
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+
+	bool ret = true;
+	if (!SetFileTime(h, NULL, NULL, &now)) {
+		LOG_E("failed SetFileTime(\"%s\"): %s", path, win32_error());
+		ret = false;
+	}
+
+	CloseHandle(h);
+	return ret;
+}
+
 bool
 fs_remove(const char *path)
 {
@@ -543,6 +571,17 @@ fs_remove(const char *path)
 	return true;
 }
 
+bool
+fs_rename(const char *src, const char *dest)
+{
+	if (!MoveFileExA(src, dest, MOVEFILE_REPLACE_EXISTING)) {
+		LOG_E("failed MoveFileEx(\"%s\", \"%s\"): %s", src, dest, win32_error());
+		return false;
+	}
+
+	return true;
+}
+
 FILE *
 fs_make_tmp_file(const char *name, const char *suffix, char *buf, uint32_t len)
 {
@@ -561,3 +600,14 @@ fs_make_tmp_file(const char *name, const char *suffix, char *buf, uint32_t len)
 
 	return fs_fopen(buf, "w+b");
 }
+
+bool
+fs_mmap(FILE *f, uint64_t len, const char **res)
+{
+	return false;
+}
+
+void
+fs_munmap(const char *p, uint64_t len)
+{
+}
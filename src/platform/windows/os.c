@@ -234,3 +234,27 @@ os_set_env(const struct str *k, const struct str *v)
 
 	putenv(buf_kv.buf);
 }
+
+uint32_t
+os_getpid(void)
+{
+	return GetCurrentProcessId();
+}
+
+bool
+os_fork(uint32_t *pid)
+{
+	return false;
+}
+
+bool
+os_wait_child(uint32_t *pid, int32_t *status)
+{
+	return false;
+}
+
+void
+os_exit_child(int32_t status)
+{
+	ExitProcess(status);
+}
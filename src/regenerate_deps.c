@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "backend/output.h"
+#include "lang/object_iterators.h"
+#include "lang/serial.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+#include "regenerate_deps.h"
+#include "tracy.h"
+
+/*
+ * The regeneration rule reruns setup whenever one of wk->regenerate_deps has
+ * a newer mtime than build.ninja, which also happens after e.g. a checkout
+ * that doesn't actually change anything.  To avoid a full reconfigure in
+ * that case, the content hash of every dependency is recorded at the end of
+ * setup, and setup -r exits early if none of them have changed.
+ */
+
+bool
+regenerate_deps_dump(struct workspace *wk, void *_ctx, FILE *out)
+{
+	obj deps, dep, hashes;
+	obj_array_dedup(wk, wk->regenerate_deps, &deps);
+	make_obj(wk, &hashes, obj_dict);
+
+	obj_array_for(wk, deps, dep) {
+		uint8_t hash[32];
+		if (!fs_sha_256_file(get_cstr(wk, dep), hash)) {
+			// Without a hash this dependency can never be
+			// considered unchanged, so don't write anything.
+			make_obj(wk, &hashes, obj_dict);
+			break;
+		}
+
+		obj_dict_set(wk, hashes, dep, make_strn(wk, (const char *)hash, 32));
+	}
+
+	return serial_dump(wk, hashes, out);
+}
+
+bool
+regenerate_deps_unchanged(struct workspace *wk)
+{
+	TracyCZoneAutoS;
+	bool ret = false;
+
+	SBUF(path);
+	path_join(wk, &path, wk->build_root, "build.ninja");
+	if (!fs_file_exists(path.buf)) {
+		goto ret;
+	}
+
+	path_join(wk, &path, wk->muon_private, output_path.regenerate_deps);
+	if (!fs_file_exists(path.buf)) {
+		goto ret;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path.buf, "rb"))) {
+		goto ret;
+	}
+
+	obj hashes;
+	bool loaded = serial_load(wk, &hashes, f);
+
+	if (!fs_fclose(f) || !loaded || get_obj_type(wk, hashes) != obj_dict || !get_obj_dict(wk, hashes)->len) {
+		goto ret;
+	}
+
+	obj dep, expected;
+	obj_dict_for(wk, hashes, dep, expected) {
+		uint8_t hash[32];
+		if (!fs_file_exists(get_cstr(wk, dep)) || !fs_sha_256_file(get_cstr(wk, dep), hash)) {
+			goto ret;
+		}
+
+		const struct str *s = get_str(wk, expected);
+		if (s->len != 32 || memcmp(s->s, hash, 32) != 0) {
+			goto ret;
+		}
+	}
+
+	ret = true;
+ret:
+	TracyCZoneAutoE;
+	return ret;
+}
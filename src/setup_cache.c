@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include "backend/output.h"
+#include "lang/object_iterators.h"
+#include "lang/serial.h"
+#include "log.h"
+#include "platform/filesystem.h"
+#include "platform/path.h"
+#include "setup_cache.h"
+
+/*
+ * A cache for expensive lookups whose results only depend on the contents of
+ * a known set of files, e.g. pkg-config resolution.  Each entry records the
+ * mtime of every file (or directory) it depends on, and is only returned if
+ * none of them have changed.  Entries that were used during a setup are
+ * written to the private dir by the backend and loaded again by the next
+ * setup.
+ */
+
+static int64_t
+setup_cache_mtime(const char *path)
+{
+	int64_t mtime;
+	if (fs_mtime(path, &mtime) != fs_mtime_result_ok) {
+		return -1;
+	}
+
+	return mtime;
+}
+
+static bool
+setup_cache_entry_valid(struct workspace *wk, obj entry)
+{
+	obj stamps, stamp;
+	obj_array_index(wk, entry, 0, &stamps);
+
+	obj_array_for(wk, stamps, stamp) {
+		obj path, mtime;
+		obj_array_index(wk, stamp, 0, &path);
+		obj_array_index(wk, stamp, 1, &mtime);
+
+		if (setup_cache_mtime(get_cstr(wk, path)) != get_obj_number(wk, mtime)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+setup_cache_get(struct workspace *wk, obj key, obj *res)
+{
+	obj entry;
+
+	// The cache is not available in bare workspaces
+	if (!wk->setup_cache.cur) {
+		return false;
+	}
+
+	if (!obj_dict_index(wk, wk->setup_cache.cur, key, &entry)
+		&& !obj_dict_index(wk, wk->setup_cache.prev, key, &entry)) {
+		return false;
+	}
+
+	// Entries are revalidated on every access since files may be
+	// generated or modified during setup.
+	if (!setup_cache_entry_valid(wk, entry)) {
+		return false;
+	}
+
+	obj_dict_set(wk, wk->setup_cache.cur, key, entry);
+	obj_array_index(wk, entry, 1, res);
+	return true;
+}
+
+void
+setup_cache_set(struct workspace *wk, obj key, obj files, obj val)
+{
+	if (!wk->setup_cache.cur) {
+		return;
+	}
+
+	obj stamps, seen, path;
+	make_obj(wk, &stamps, obj_array);
+	make_obj(wk, &seen, obj_dict);
+
+	obj_array_for(wk, files, path) {
+		if (obj_dict_in(wk, seen, path)) {
+			continue;
+		}
+		obj_dict_set(wk, seen, path, path);
+
+		obj stamp;
+		make_obj(wk, &stamp, obj_array);
+		obj_array_push(wk, stamp, path);
+		obj_array_push(wk, stamp, make_number(wk, setup_cache_mtime(get_cstr(wk, path))));
+		obj_array_push(wk, stamps, stamp);
+	}
+
+	obj entry;
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, stamps);
+	obj_array_push(wk, entry, val);
+	obj_dict_set(wk, wk->setup_cache.cur, key, entry);
+}
+
+bool
+setup_cache_load(struct workspace *wk)
+{
+	SBUF(path);
+	path_join(wk, &path, wk->muon_private, output_path.setup_cache);
+
+	if (!fs_file_exists(path.buf)) {
+		return true;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path.buf, "rb"))) {
+		return false;
+	}
+
+	obj loaded;
+	bool ret = serial_load(wk, &loaded, f);
+
+	if (!fs_fclose(f)) {
+		ret = false;
+	}
+
+	if (!ret || get_obj_type(wk, loaded) != obj_dict) {
+		return false;
+	}
+
+	// Copy the loaded entries into a fresh dict.  Dicts created by
+	// serial_load are not hashed, which would make lookups linear.
+	obj k, v;
+	obj_dict_for(wk, loaded, k, v) {
+		obj_dict_set(wk, wk->setup_cache.prev, k, v);
+	}
+
+	return true;
+}
+
+bool
+setup_cache_dump(struct workspace *wk, void *_ctx, FILE *out)
+{
+	return serial_dump(wk, wk->setup_cache.cur, out);
+}
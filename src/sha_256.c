@@ -10,7 +10,18 @@
 
 #include "sha_256.h"
 
-#define CHUNK_SIZE 64
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__TINYC__) \
+	&& (defined(__clang__) || __GNUC__ >= 5)
+#define SHA_256_X86_SHA_NI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define SHA_256_ARMV8_CRYPTO
+#include <arm_neon.h>
+#endif
+
 #define TOTAL_LEN_LEN 8
 
 /*
@@ -91,14 +102,6 @@ static const uint32_t k[] = { 0x428a2f98,
 	0xbef9a3f7,
 	0xc67178f2 };
 
-struct buffer_state {
-	const uint8_t *p;
-	size_t len;
-	size_t total_len;
-	int single_one_delivered; /* bool */
-	int total_len_delivered; /* bool */
-};
-
 static inline uint32_t
 right_rot(uint32_t value, unsigned int count)
 {
@@ -108,183 +111,449 @@ right_rot(uint32_t value, unsigned int count)
 	return value >> count | value << (32 - count);
 }
 
+/*
+ * Note 1: All integers (expect indexes) are 32-bit unsigned integers and addition is calculated modulo 2^32.
+ *
+ * Note 2: For each round, there is one round constant k[i] and one entry in the message schedule array w[i], 0 <= i
+ * <= 63.
+ *
+ * Note 3: The compression function uses 8 working variables, a through h.
+ *
+ * Note 4: Big-endian convention is used when expressing the constants in this pseudocode, and when parsing message
+ * block data from bytes to words, for example, the first word of the input message "abc" after padding is
+ * 0x61626380.
+ */
 static void
-init_buf_state(struct buffer_state *state, const void *input, size_t len)
+consume_chunk(uint32_t *h, const uint8_t *p)
 {
-	state->p = input;
-	state->len = len;
-	state->total_len = len;
-	state->single_one_delivered = 0;
-	state->total_len_delivered = 0;
+	unsigned i, j;
+	uint32_t ah[8];
+
+	/* Initialize working variables to current hash value: */
+	for (i = 0; i < 8; i++) {
+		ah[i] = h[i];
+	}
+
+	/*
+	 * The w-array is really w[64], but since we only need 16 of them at a time, we save stack by calculating 16 at
+	 * a time.
+	 *
+	 * This optimization was not there initially and the rest of the comments about w[64] are kept in their
+	 * initial state.
+	 */
+
+	/*
+	 * create a 64-entry message schedule array w[0..63] of 32-bit words (The initial values in w[0..63] don't
+	 * matter, so many implementations zero them here) copy chunk into first 16 words w[0..15] of the message
+	 * schedule array
+	 */
+	uint32_t w[16];
+
+	/* Compression function main loop: */
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 16; j++) {
+			if (i == 0) {
+				w[j] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+				p += 4;
+			} else {
+				/* Extend the first 16 words into the remaining 48 words w[16..63] of the message
+				 * schedule array: */
+				const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7) ^ right_rot(w[(j + 1) & 0xf], 18)
+						    ^ (w[(j + 1) & 0xf] >> 3);
+				const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17) ^ right_rot(w[(j + 14) & 0xf], 19)
+						    ^ (w[(j + 14) & 0xf] >> 10);
+				w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
+			}
+			const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
+			const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
+			const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
+			const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
+			const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
+			const uint32_t temp2 = s0 + maj;
+
+			ah[7] = ah[6];
+			ah[6] = ah[5];
+			ah[5] = ah[4];
+			ah[4] = ah[3] + temp1;
+			ah[3] = ah[2];
+			ah[2] = ah[1];
+			ah[1] = ah[0];
+			ah[0] = temp1 + temp2;
+		}
+	}
+
+	/* Add the compressed chunk to the current hash value: */
+	for (i = 0; i < 8; i++) {
+		h[i] += ah[i];
+	}
 }
 
-static inline const uint8_t *
-calc_chunk(uint8_t chunk[CHUNK_SIZE], struct buffer_state *state)
+static void
+consume_chunks_generic(uint32_t *h, const uint8_t *p, size_t n)
 {
-	if (state->total_len_delivered) {
-		return NULL;
+	for (; n; --n, p += SHA_256_CHUNK_SIZE) {
+		consume_chunk(h, p);
 	}
+}
+
+#ifdef SHA_256_X86_SHA_NI
+/*
+ * x86 SHA extensions.  The state is kept as ABEF/CDGH, which is the layout
+ * expected by sha256rnds2, and each call to sha_256_x86_rounds() processes 4
+ * rounds.
+ */
+#define SHA_256_X86_TARGET __attribute__((target("sha,sse4.1")))
+
+SHA_256_X86_TARGET static inline __m128i
+sha_256_x86_schedule(__m128i w_4, __m128i w_3, __m128i w_2, __m128i w_1)
+{
+	__m128i w = _mm_sha256msg1_epu32(w_4, w_3);
+	w = _mm_add_epi32(w, _mm_alignr_epi8(w_1, w_2, 4));
+	return _mm_sha256msg2_epu32(w, w_1);
+}
+
+SHA_256_X86_TARGET static inline void
+sha_256_x86_rounds(__m128i *state0, __m128i *state1, __m128i w, const uint32_t *k4)
+{
+	__m128i msg = _mm_add_epi32(w, _mm_loadu_si128((const __m128i *)k4));
+	*state1 = _mm_sha256rnds2_epu32(*state1, *state0, msg);
+	*state0 = _mm_sha256rnds2_epu32(*state0, *state1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+SHA_256_X86_TARGET static void
+consume_chunks_x86_sha_ni(uint32_t *h, const uint8_t *p, size_t n)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, tmp, w0, w1, w2, w3;
+	unsigned i;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xb1); // CDAB
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1b); // EFGH
+	state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0); // CDGH
+
+	for (; n; --n, p += SHA_256_CHUNK_SIZE) {
+		abef = state0;
+		cdgh = state1;
+
+		w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&p[0]), mask);
+		w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&p[16]), mask);
+		w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&p[32]), mask);
+		w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&p[48]), mask);
 
-	/* For whole chunks, there is no need to copy data, we just return the original chunk. */
-	if (state->len >= CHUNK_SIZE) {
-		const uint8_t *const chunk_start = state->p;
-		state->p += CHUNK_SIZE;
-		state->len -= CHUNK_SIZE;
-		return chunk_start;
+		for (i = 0; i < 64; i += 16) {
+			if (i) {
+				w0 = sha_256_x86_schedule(w0, w1, w2, w3);
+			}
+			sha_256_x86_rounds(&state0, &state1, w0, &k[i]);
+
+			if (i) {
+				w1 = sha_256_x86_schedule(w1, w2, w3, w0);
+			}
+			sha_256_x86_rounds(&state0, &state1, w1, &k[i + 4]);
+
+			if (i) {
+				w2 = sha_256_x86_schedule(w2, w3, w0, w1);
+			}
+			sha_256_x86_rounds(&state0, &state1, w2, &k[i + 8]);
+
+			if (i) {
+				w3 = sha_256_x86_schedule(w3, w0, w1, w2);
+			}
+			sha_256_x86_rounds(&state0, &state1, w3, &k[i + 12]);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
 	}
 
-	const uint8_t *const chunk_start = chunk;
-	memcpy(chunk, state->p, state->len);
-	chunk += state->len;
-	size_t space_in_chunk = CHUNK_SIZE - state->len;
-	state->p += state->len;
-	state->len = 0;
-
-	/* If we are here, space_in_chunk is one at minimum. */
-	if (!state->single_one_delivered) {
-		*chunk++ = 0x80;
-		space_in_chunk -= 1;
-		state->single_one_delivered = 1;
+	tmp = _mm_shuffle_epi32(state0, 0x1b); // FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xb1); // DCHG
+	_mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(tmp, state1, 0xf0)); // DCBA
+	_mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+static int
+sha_256_x86_sha_ni_supported(void)
+{
+	unsigned a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d)) {
+		return 0;
 	}
 
-	/*
-	 * Now:
-	 * - either there is enough space left for the total length, and we can conclude,
-	 * - or there is too little space left, and we have to pad the rest of this chunk with zeroes. In the latter
-	 *   case, we will conclude at the next invocation of this function.
-	 */
-	if (space_in_chunk >= TOTAL_LEN_LEN) {
-		const size_t left = space_in_chunk - TOTAL_LEN_LEN;
-		size_t len = state->total_len;
-		int i;
-		memset(chunk, 0x00, left);
-		chunk += left;
-
-		/* Storing of len * 8 as a big endian 64-bit without overflow. */
-		chunk[7] = (uint8_t)(len << 3);
-		len >>= 5;
-		for (i = 6; i >= 0; i--) {
-			chunk[i] = (uint8_t)len;
-			len >>= 8;
-		}
-		state->total_len_delivered = 1;
-	} else {
-		memset(chunk, 0x00, space_in_chunk);
+	// SSSE3 and SSE4.1
+	if (!(c & (1 << 9)) || !(c & (1 << 19))) {
+		return 0;
+	}
+
+	if (__get_cpuid_max(0, 0) < 7) {
+		return 0;
 	}
 
-	return chunk_start;
+	// SHA
+	__cpuid_count(7, 0, a, b, c, d);
+	return !!(b & (1 << 29));
 }
+#endif
 
+#ifdef SHA_256_ARMV8_CRYPTO
 /*
- * Limitations:
- * - Since input is a pointer, the data to hash must be directly accessible to the processor, which could be a problem
- *   for large data sizes.
- * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support for bit string
- *   lengths that are not multiples of eight, and it really operates on arrays of bytes.  In particular, the len
- *   parameter is a number of bytes.
+ * ARMv8 cryptography extensions.  These are only used when they are enabled
+ * at compile time, e.g. with -march=armv8-a+crypto, in which case they are
+ * always available.
  */
-void
-calc_sha_256(uint8_t hash[32], const void *input, size_t len)
+static inline uint32x4_t
+sha_256_armv8_schedule(uint32x4_t w_4, uint32x4_t w_3, uint32x4_t w_2, uint32x4_t w_1)
 {
-	/*
-	 * Note 1: All integers (expect indexes) are 32-bit unsigned integers and addition is calculated modulo 2^32.
-	 *
-	 * Note 2: For each round, there is one round constant k[i] and one entry in the message schedule array w[i], 0
-	 * <= i <= 63.
-	 *
-	 * Note 3: The compression function uses 8 working variables, a through h.
-	 *
-	 * Note 4: Big-endian convention is used when expressing the constants in this pseudocode, and when parsing
-	 * message block data from bytes to words, for example, the first word of the input message "abc" after padding
-	 * is 0x61626380.
-	 */
+	return vsha256su1q_u32(vsha256su0q_u32(w_4, w_3), w_2, w_1);
+}
 
-	/*
-	 * Initialize hash values (first 32 bits of the fractional parts of the square roots of the first 8 primes
-	 * 2..19):
-	 */
-	uint32_t h[]
-		= { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
-	unsigned i, j;
+static inline void
+sha_256_armv8_rounds(uint32x4_t *state0, uint32x4_t *state1, uint32x4_t w, const uint32_t *k4)
+{
+	uint32x4_t msg = vaddq_u32(w, vld1q_u32(k4)), tmp = *state0;
+	*state0 = vsha256hq_u32(*state0, *state1, msg);
+	*state1 = vsha256h2q_u32(*state1, tmp, msg);
+}
 
-	/* 512-bit chunks is what we will operate on. */
-	uint8_t chunk[CHUNK_SIZE];
+static void
+consume_chunks_armv8_crypto(uint32_t *h, const uint8_t *p, size_t n)
+{
+	uint32x4_t state0 = vld1q_u32(&h[0]), state1 = vld1q_u32(&h[4]);
+	uint32x4_t abcd, efgh, w0, w1, w2, w3;
+	unsigned i;
 
-	struct buffer_state state;
+	for (; n; --n, p += SHA_256_CHUNK_SIZE) {
+		abcd = state0;
+		efgh = state1;
 
-	init_buf_state(&state, input, len);
+		w0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&p[0])));
+		w1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&p[16])));
+		w2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&p[32])));
+		w3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&p[48])));
 
-	const uint8_t *p;
+		for (i = 0; i < 64; i += 16) {
+			if (i) {
+				w0 = sha_256_armv8_schedule(w0, w1, w2, w3);
+			}
+			sha_256_armv8_rounds(&state0, &state1, w0, &k[i]);
+
+			if (i) {
+				w1 = sha_256_armv8_schedule(w1, w2, w3, w0);
+			}
+			sha_256_armv8_rounds(&state0, &state1, w1, &k[i + 4]);
 
-	while ((p = calc_chunk(chunk, &state))) {
-		uint32_t ah[8];
+			if (i) {
+				w2 = sha_256_armv8_schedule(w2, w3, w0, w1);
+			}
+			sha_256_armv8_rounds(&state0, &state1, w2, &k[i + 8]);
 
-		/* Initialize working variables to current hash value: */
-		for (i = 0; i < 8; i++) {
-			ah[i] = h[i];
+			if (i) {
+				w3 = sha_256_armv8_schedule(w3, w0, w1, w2);
+			}
+			sha_256_armv8_rounds(&state0, &state1, w3, &k[i + 12]);
 		}
 
-		/*
-		 * The w-array is really w[64], but since we only need 16 of them at a time, we save stack by
-		 * calculating 16 at a time.
-		 *
-		 * This optimization was not there initially and the rest of the comments about w[64] are kept in their
-		 * initial state.
-		 */
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+	}
 
-		/*
-		 * create a 64-entry message schedule array w[0..63] of 32-bit words (The initial values in w[0..63]
-		 * don't matter, so many implementations zero them here) copy chunk into first 16 words w[0..15] of the
-		 * message schedule array
-		 */
-		uint32_t w[16];
-
-		/* Compression function main loop: */
-		for (i = 0; i < 4; i++) {
-			for (j = 0; j < 16; j++) {
-				if (i == 0) {
-					w[j] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8
-					       | (uint32_t)p[3];
-					p += 4;
-				} else {
-					/* Extend the first 16 words into the remaining 48 words w[16..63] of the
-					 * message schedule array: */
-					const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7)
-							    ^ right_rot(w[(j + 1) & 0xf], 18) ^ (w[(j + 1) & 0xf] >> 3);
-					const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17)
-							    ^ right_rot(w[(j + 14) & 0xf], 19)
-							    ^ (w[(j + 14) & 0xf] >> 10);
-					w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
-				}
-				const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
-				const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
-				const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
-				const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
-				const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
-				const uint32_t temp2 = s0 + maj;
-
-				ah[7] = ah[6];
-				ah[6] = ah[5];
-				ah[5] = ah[4];
-				ah[4] = ah[3] + temp1;
-				ah[3] = ah[2];
-				ah[2] = ah[1];
-				ah[1] = ah[0];
-				ah[0] = temp1 + temp2;
+	vst1q_u32(&h[0], state0);
+	vst1q_u32(&h[4], state1);
+}
+#endif
+
+typedef void (*consume_chunks_func)(uint32_t *h, const uint8_t *p, size_t n);
+
+static const struct {
+	const char *name;
+	consume_chunks_func func;
+} sha_256_impls[sha_256_impl_count] = {
+	[sha_256_impl_generic] = { "generic", consume_chunks_generic },
+#ifdef SHA_256_X86_SHA_NI
+	[sha_256_impl_x86_sha_ni] = { "x86 sha-ni", consume_chunks_x86_sha_ni },
+#endif
+#ifdef SHA_256_ARMV8_CRYPTO
+	[sha_256_impl_armv8_crypto] = { "armv8 crypto", consume_chunks_armv8_crypto },
+#endif
+};
+
+static consume_chunks_func consume_chunks;
+static enum sha_256_impl sha_256_selected_impl;
+
+int
+sha_256_impl_supported(enum sha_256_impl impl)
+{
+	if (!sha_256_impls[impl].func) {
+		return 0;
+	}
+
+	switch (impl) {
+#ifdef SHA_256_X86_SHA_NI
+	case sha_256_impl_x86_sha_ni: return sha_256_x86_sha_ni_supported();
+#endif
+	default: return 1;
+	}
+}
+
+int
+sha_256_impl_select(enum sha_256_impl impl)
+{
+	if (!sha_256_impl_supported(impl)) {
+		return 0;
+	}
+
+	sha_256_selected_impl = impl;
+	consume_chunks = sha_256_impls[impl].func;
+	return 1;
+}
+
+enum sha_256_impl
+sha_256_impl_get(void)
+{
+	if (!consume_chunks) {
+		/* Pick the first supported implementation, preferring hardware ones. */
+		int impl;
+		for (impl = sha_256_impl_count - 1; impl >= 0; --impl) {
+			if (sha_256_impl_select(impl)) {
+				break;
 			}
 		}
+	}
+
+	return sha_256_selected_impl;
+}
 
-		/* Add the compressed chunk to the current hash value: */
-		for (i = 0; i < 8; i++) {
-			h[i] += ah[i];
+const char *
+sha_256_impl_name(enum sha_256_impl impl)
+{
+	return sha_256_impls[impl].name;
+}
+
+void
+sha_256_init(struct sha_256 *sha_256, uint8_t hash[SHA_256_HASH_SIZE])
+{
+	if (!consume_chunks) {
+		(void)sha_256_impl_get();
+	}
+
+	sha_256->hash = hash;
+	sha_256->chunk_pos = sha_256->chunk;
+	sha_256->space_left = SHA_256_CHUNK_SIZE;
+	sha_256->total_len = 0;
+	/*
+	 * Initialize hash values (first 32 bits of the fractional parts of the square roots of the first 8 primes
+	 * 2..19):
+	 */
+	sha_256->h[0] = 0x6a09e667;
+	sha_256->h[1] = 0xbb67ae85;
+	sha_256->h[2] = 0x3c6ef372;
+	sha_256->h[3] = 0xa54ff53a;
+	sha_256->h[4] = 0x510e527f;
+	sha_256->h[5] = 0x9b05688c;
+	sha_256->h[6] = 0x1f83d9ab;
+	sha_256->h[7] = 0x5be0cd19;
+}
+
+void
+sha_256_write(struct sha_256 *sha_256, const void *data, size_t len)
+{
+	sha_256->total_len += len;
+
+	const uint8_t *p = data;
+
+	while (len > 0) {
+		/*
+		 * If the input chunks have sizes that are multiples of the calculation chunk size, no copies are
+		 * necessary. We operate directly on the input data instead.
+		 */
+		if (sha_256->space_left == SHA_256_CHUNK_SIZE && len >= SHA_256_CHUNK_SIZE) {
+			const size_t chunks = len / SHA_256_CHUNK_SIZE;
+			consume_chunks(sha_256->h, p, chunks);
+			len -= chunks * SHA_256_CHUNK_SIZE;
+			p += chunks * SHA_256_CHUNK_SIZE;
+			continue;
 		}
+		/* General case, no particular optimization. */
+		const size_t consumed_len = len < sha_256->space_left ? len : sha_256->space_left;
+		memcpy(sha_256->chunk_pos, p, consumed_len);
+		sha_256->space_left -= consumed_len;
+		len -= consumed_len;
+		p += consumed_len;
+		if (sha_256->space_left == 0) {
+			consume_chunks(sha_256->h, sha_256->chunk, 1);
+			sha_256->chunk_pos = sha_256->chunk;
+			sha_256->space_left = SHA_256_CHUNK_SIZE;
+		} else {
+			sha_256->chunk_pos += consumed_len;
+		}
+	}
+}
+
+uint8_t *
+sha_256_close(struct sha_256 *sha_256)
+{
+	uint8_t *pos = sha_256->chunk_pos;
+	size_t space_left = sha_256->space_left;
+	uint32_t *const h = sha_256->h;
+	unsigned i, j;
+
+	/*
+	 * The current chunk cannot be full. Otherwise, it would already have been consumed. I.e. there is space left
+	 * for at least one byte. The next step in the calculation is to add a single one-bit to the data.
+	 */
+	*pos++ = 0x80;
+	--space_left;
+
+	/*
+	 * Now, the last step is to add the total data length at the end of the last chunk, and zero padding before
+	 * that. But we do not necessarily have enough space left. If not, we pad the current chunk with zeroes, and add
+	 * an extra chunk at the end.
+	 */
+	if (space_left < TOTAL_LEN_LEN) {
+		memset(pos, 0x00, space_left);
+		consume_chunks(h, sha_256->chunk, 1);
+		pos = sha_256->chunk;
+		space_left = SHA_256_CHUNK_SIZE;
+	}
+	const size_t left = space_left - TOTAL_LEN_LEN;
+	memset(pos, 0x00, left);
+	pos += left;
+	uint64_t len = sha_256->total_len;
+	pos[7] = (uint8_t)(len << 3);
+	len >>= 5;
+	int k;
+	for (k = 6; k >= 0; --k) {
+		pos[k] = (uint8_t)len;
+		len >>= 8;
 	}
+	consume_chunks(h, sha_256->chunk, 1);
 
 	/* Produce the final hash value (big-endian): */
+	uint8_t *const hash = sha_256->hash;
 	for (i = 0, j = 0; i < 8; i++) {
 		hash[j++] = (uint8_t)(h[i] >> 24);
 		hash[j++] = (uint8_t)(h[i] >> 16);
 		hash[j++] = (uint8_t)(h[i] >> 8);
 		hash[j++] = (uint8_t)h[i];
 	}
+	return sha_256->hash;
+}
+
+/*
+ * Limitations:
+ * - Since input is a pointer, the data to hash must be directly accessible to the processor, which could be a problem
+ *   for large data sizes.
+ * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support for bit string
+ *   lengths that are not multiples of eight, and it really operates on arrays of bytes.  In particular, the len
+ *   parameter is a number of bytes.
+ */
+void
+calc_sha_256(uint8_t hash[SHA_256_HASH_SIZE], const void *input, size_t len)
+{
+	struct sha_256 sha_256;
+	sha_256_init(&sha_256, hash);
+	sha_256_write(&sha_256, input, len);
+	(void)sha_256_close(&sha_256);
 }
@@ -0,0 +1,469 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "backend/output.h"
+#include "functions/kernel/subproject.h"
+#include "lang/compiler.h"
+#include "lang/object_iterators.h"
+#include "lang/parser.h"
+#include "lang/serial.h"
+#include "log.h"
+#include "platform/filesystem.h"
+#include "platform/mem.h"
+#include "platform/os.h"
+#include "platform/path.h"
+#include "platform/timer.h"
+#include "subproject_workers.h"
+
+/*
+ * With `muon setup -j <jobs>`, the first call to subproject() forks a worker
+ * process for every subproject that the current project requests with a
+ * literal subproject() call, either in its own meson.build or in one reached
+ * through a literal subdir() call.  Only calls at the top level of a file are
+ * considered, i.e. not in an if, foreach, or function body, and only if their
+ * name, default_options, version and required keywords are all literals, so
+ * that the worker evaluates the subproject exactly as the parent will.  The
+ * subproject must also already be present in the subprojects dir; wraps that
+ * still need to be fetched are left to the sequential evaluation.
+ *
+ * Each worker has its own copy of the workspace, evaluates its subproject
+ * with its own private dir (so that compiler check temporaries don't collide)
+ * and a build root inside of it (so that configure_file() and the like don't
+ * race with the parent), and writes out its compiler check cache and setup
+ * cache.  Workers never handle wraps, so they don't modify the source tree,
+ * and they stop at the first command that the subproject runs with
+ * run_command() or configure_file(command: ...), so that only the parent ever
+ * runs those.
+ *
+ * Once all workers have finished, their caches are merged into the main
+ * workspace in name order and evaluation continues sequentially as usual, now
+ * mostly answering compiler checks and dependency lookups from the cache.
+ * Since the main workspace still evaluates every subproject itself, in the
+ * usual order, option yields, dependency overrides, and all other output are
+ * exactly the same as without -j.  A worker for a subproject that depends on
+ * another subproject may fail part way through, in which case it just
+ * contributes fewer cache entries.
+ */
+
+#define SUBPROJECT_WORKERS_CACHES "caches.dat"
+#define SUBPROJECT_WORKERS_LOG "log.txt"
+
+struct subproject_workers_scan_ctx {
+	struct workspace *wk;
+	/* name -> dict of literal keyword arguments, or false if any call for
+	 * that name can't be reproduced by a worker */
+	obj requests;
+	obj scanned;
+};
+
+static void subproject_workers_scan_file(struct subproject_workers_scan_ctx *ctx, const char *dir);
+
+static bool
+subproject_workers_literal(struct workspace *wk, const struct node *n, obj *res)
+{
+	switch (n->type) {
+	case node_type_string: *res = n->data.str; return true;
+	case node_type_number: *res = make_number(wk, n->data.num); return true;
+	case node_type_bool: *res = n->data.num ? obj_bool_true : obj_bool_false; return true;
+	case node_type_array:
+	case node_type_dict: {
+		make_obj(wk, res, n->type == node_type_array ? obj_array : obj_dict);
+
+		obj k, v;
+		for (; n; n = n->r) {
+			if (!n->l) {
+				continue;
+			} else if (n->l->type == node_type_kw) {
+				if (n->l->r->type != node_type_string || !subproject_workers_literal(wk, n->l->l, &v)) {
+					return false;
+				}
+
+				obj_dict_set(wk, *res, n->l->r->data.str, v);
+			} else {
+				if (!subproject_workers_literal(wk, n->l, &k)) {
+					return false;
+				}
+
+				obj_array_push(wk, *res, k);
+			}
+		}
+		return true;
+	}
+	default: return false;
+	}
+}
+
+static void
+subproject_workers_scan_call(struct subproject_workers_scan_ctx *ctx, const struct node *n, const char *dir)
+{
+	struct workspace *wk = ctx->wk;
+	const char *func = get_cstr(wk, n->r->data.str);
+	bool is_subproject = strcmp(func, "subproject") == 0, is_subdir = strcmp(func, "subdir") == 0;
+
+	if (!is_subproject && !is_subdir) {
+		return;
+	}
+
+	const struct node *args = n->l;
+	if (!args->l || args->l->type != node_type_string) {
+		return;
+	}
+
+	obj name = args->l->data.str, kwargs, v;
+	bool literal = true;
+	make_obj(wk, &kwargs, obj_dict);
+
+	for (args = args->r; args; args = args->r) {
+		if (!args->l) {
+			continue;
+		} else if (args->l->type != node_type_kw || !subproject_workers_literal(wk, args->l->l, &v)) {
+			literal = false;
+			break;
+		}
+
+		obj_dict_set(wk, kwargs, args->l->r->data.str, v);
+	}
+
+	if (is_subdir) {
+		// subdir(if_found: ...) may not be entered
+		if (literal && !get_obj_dict(wk, kwargs)->len) {
+			SBUF(subdir);
+			path_join(wk, &subdir, dir, get_cstr(wk, name));
+			subproject_workers_scan_file(ctx, subdir.buf);
+		}
+		return;
+	}
+
+	if (literal && obj_dict_index_str(wk, kwargs, "required", &v) && get_obj_type(wk, v) != obj_bool) {
+		literal = false;
+	}
+
+	// Only the first call evaluates the subproject
+	if (!obj_dict_in(wk, ctx->requests, name)) {
+		obj_dict_set(wk, ctx->requests, name, literal ? kwargs : obj_bool_false);
+	}
+}
+
+static void
+subproject_workers_scan_expr(struct subproject_workers_scan_ctx *ctx, const struct node *n, const char *dir)
+{
+	if (!n) {
+		return;
+	}
+
+	switch (n->type) {
+	// Anything past a branch might not be evaluated
+	case node_type_if:
+	case node_type_foreach:
+	case node_type_func_def:
+	case node_type_ternary:
+	case node_type_and:
+	case node_type_or: return;
+	case node_type_call:
+		if (n->r->type == node_type_id_lit) {
+			subproject_workers_scan_call(ctx, n, dir);
+		}
+		break;
+	default: break;
+	}
+
+	subproject_workers_scan_expr(ctx, n->l, dir);
+	subproject_workers_scan_expr(ctx, n->r, dir);
+}
+
+static void
+subproject_workers_scan_file(struct subproject_workers_scan_ctx *ctx, const char *dir)
+{
+	struct workspace *wk = ctx->wk;
+
+	SBUF(path);
+	path_join(wk, &path, dir, "meson.build");
+
+	obj key = make_str(wk, path.buf);
+	if (obj_dict_in(wk, ctx->scanned, key)) {
+		return;
+	}
+	obj_dict_set(wk, ctx->scanned, key, obj_bool_true);
+
+	struct source src = { 0 };
+	if (!fs_file_exists(path.buf) || !fs_read_entire_file(path.buf, &src)) {
+		return;
+	}
+
+	const struct node *n = parse(wk, &src, vm_compile_mode_quiet);
+	fs_source_destroy(&src);
+
+	for (; n; n = n->r) {
+		subproject_workers_scan_expr(ctx, n->l, dir);
+	}
+}
+
+static bool
+subproject_workers_dump(struct workspace *wk, const char *dir)
+{
+	obj caches;
+	make_obj(wk, &caches, obj_array);
+	obj_array_push(wk, caches, wk->compiler_check_cache);
+	obj_array_push(wk, caches, wk->setup_cache.cur);
+
+	FILE *out;
+	if (!(out = output_open(dir, SUBPROJECT_WORKERS_CACHES))) {
+		return false;
+	}
+
+	bool ret = serial_dump(wk, caches, out);
+
+	if (!fs_fclose(out)) {
+		ret = false;
+	}
+
+	return ret;
+}
+
+static void
+subproject_workers_child(struct workspace *wk, obj name, obj kwargs, const char *dir)
+{
+	SBUF(path);
+	path_join(wk, &path, dir, SUBPROJECT_WORKERS_LOG);
+
+	FILE *log;
+	if (!(log = fs_fopen(path.buf, "wb"))) {
+		os_exit_child(1);
+	}
+	log_set_file(log);
+
+	wk->subproject_workers.jobs = 0;
+	wk->subproject_workers.parent_private = wk->muon_private;
+	wk->muon_private = dir;
+
+	SBUF(build_root);
+	path_join(wk, &build_root, dir, "build");
+	if (!fs_mkdir_p(build_root.buf)) {
+		os_exit_child(1);
+	}
+	current_project(wk)->build_root = sbuf_into_str(wk, &build_root);
+	wk->build_root = get_cstr(wk, current_project(wk)->build_root);
+
+	struct args_kw default_options = { 0 }, version = { 0 };
+	default_options.set = obj_dict_index_str(wk, kwargs, "default_options", &default_options.val);
+	obj v;
+	if ((version.set = obj_dict_index_str(wk, kwargs, "version", &v))) {
+		if (get_obj_type(wk, v) == obj_array) {
+			version.val = v;
+		} else {
+			make_obj(wk, &version.val, obj_array);
+			obj_array_push(wk, version.val, v);
+		}
+	}
+
+	// Errors are only reported in the worker's log, the subproject will be
+	// evaluated again by the parent.
+	obj res;
+	subproject(wk, name, requirement_auto, &default_options, &version, &res);
+
+	bool ok = subproject_workers_dump(wk, dir);
+	fflush(log);
+	os_exit_child(ok ? 0 : 1);
+}
+
+void
+subproject_workers_before_command(struct workspace *wk)
+{
+	if (!wk->subproject_workers.parent_private) {
+		return;
+	}
+
+	// Keep what was cached up to this point
+	bool ok = subproject_workers_dump(wk, wk->muon_private);
+	fflush(NULL);
+	os_exit_child(ok ? 0 : 1);
+}
+
+static void
+subproject_workers_merge_dict(struct workspace *wk, obj dest, obj src, obj skip)
+{
+	obj k, v;
+	obj_dict_for(wk, src, k, v) {
+		if (obj_dict_in(wk, dest, k) || (skip && obj_dict_in(wk, skip, k))) {
+			continue;
+		}
+
+		obj_dict_set(wk, dest, k, v);
+	}
+}
+
+static bool
+subproject_workers_merge(struct workspace *wk, const char *dir)
+{
+	SBUF(path);
+	path_join(wk, &path, dir, SUBPROJECT_WORKERS_CACHES);
+
+	if (!fs_file_exists(path.buf)) {
+		return false;
+	}
+
+	FILE *f;
+	if (!(f = fs_fopen(path.buf, "rb"))) {
+		return false;
+	}
+
+	obj caches;
+	bool ret = serial_load(wk, &caches, f);
+
+	if (!fs_fclose(f)) {
+		ret = false;
+	}
+
+	if (!ret || get_obj_type(wk, caches) != obj_array || get_obj_array(wk, caches)->len != 2) {
+		return false;
+	}
+
+	obj checks, lookups;
+	obj_array_index(wk, caches, 0, &checks);
+	obj_array_index(wk, caches, 1, &lookups);
+	if (get_obj_type(wk, checks) != obj_dict || get_obj_type(wk, lookups) != obj_dict) {
+		return false;
+	}
+
+	subproject_workers_merge_dict(wk, wk->compiler_check_cache, checks, 0);
+	// Setup cache entries are revalidated when they are used, so they are
+	// merged as if they had been loaded from the previous setup.
+	subproject_workers_merge_dict(wk, wk->setup_cache.prev, lookups, wk->setup_cache.cur);
+	return true;
+}
+
+static bool
+subproject_workers_wait(uint32_t *pids, uint32_t *running)
+{
+	uint32_t pid, i;
+	int32_t status;
+
+	if (!os_wait_child(&pid, &status)) {
+		return false;
+	}
+
+	for (i = 0; i < *running; ++i) {
+		if (pids[i] == pid) {
+			pids[i] = pids[--*running];
+			break;
+		}
+	}
+
+	return true;
+}
+
+void
+subproject_workers_run(struct workspace *wk)
+{
+	if (!wk->subproject_workers.jobs || wk->subproject_workers.started) {
+		return;
+	}
+
+	wk->subproject_workers.started = true;
+
+	SBUF(subprojects_dir);
+	path_join(wk,
+		&subprojects_dir,
+		get_cstr(wk, current_project(wk)->source_root),
+		get_cstr(wk, current_project(wk)->subprojects_dir));
+
+	struct subproject_workers_scan_ctx scan_ctx = { .wk = wk };
+	make_obj(wk, &scan_ctx.requests, obj_dict);
+	make_obj(wk, &scan_ctx.scanned, obj_dict);
+	subproject_workers_scan_file(&scan_ctx, get_cstr(wk, current_project(wk)->source_root));
+	vm_compile_state_reset(wk);
+
+	obj requested, names, name, kwargs;
+	make_obj(wk, &requested, obj_array);
+	obj_dict_for(wk, scan_ctx.requests, name, kwargs) {
+		if (kwargs == obj_bool_false) {
+			continue;
+		}
+
+		SBUF(path);
+		path_join(wk, &path, subprojects_dir.buf, get_cstr(wk, name));
+		path_push(wk, &path, "meson.build");
+		if (fs_file_exists(path.buf)) {
+			obj_array_push(wk, requested, name);
+		}
+	}
+	obj_array_sort(wk, NULL, requested, obj_array_sort_by_str, &names);
+
+	if (!get_obj_array(wk, names)->len) {
+		return;
+	}
+
+	struct timer t;
+	timer_start(&t);
+
+	SBUF(workers_dir);
+	path_join(wk, &workers_dir, wk->muon_private, output_path.subproject_workers);
+
+	uint32_t *pids = z_calloc(wk->subproject_workers.jobs, sizeof(uint32_t));
+	uint32_t running = 0;
+
+	obj started;
+	make_obj(wk, &started, obj_array);
+
+	obj_array_for(wk, names, name) {
+		while (running >= wk->subproject_workers.jobs) {
+			if (!subproject_workers_wait(pids, &running)) {
+				goto wait_all;
+			}
+		}
+
+		SBUF(dir);
+		path_join(wk, &dir, workers_dir.buf, get_cstr(wk, name));
+		if (!fs_mkdir_p(dir.buf)) {
+			continue;
+		}
+
+		SBUF(caches);
+		path_join(wk, &caches, dir.buf, SUBPROJECT_WORKERS_CACHES);
+		if (fs_exists(caches.buf) && !fs_remove(caches.buf)) {
+			continue;
+		}
+
+		// Don't let the worker inherit unflushed output
+		fflush(NULL);
+
+		uint32_t pid;
+		if (!os_fork(&pid)) {
+			LOG_W("failed to start subproject worker, continuing sequentially");
+			break;
+		} else if (!pid) {
+			obj_dict_index(wk, scan_ctx.requests, name, &kwargs);
+			subproject_workers_child(wk, name, kwargs, dir.buf);
+		}
+
+		pids[running] = pid;
+		++running;
+		obj_array_push(wk, started, name);
+	}
+
+wait_all:
+	while (running) {
+		if (!subproject_workers_wait(pids, &running)) {
+			break;
+		}
+	}
+
+	z_free(pids);
+
+	uint32_t merged = 0;
+	obj_array_for(wk, started, name) {
+		SBUF(dir);
+		path_join(wk, &dir, workers_dir.buf, get_cstr(wk, name));
+		if (subproject_workers_merge(wk, dir.buf)) {
+			++merged;
+		}
+	}
+
+	LOG_I("evaluated %d subprojects in parallel in %.3fs", merged, timer_read(&t));
+}
@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include "compat.h"
+
+#include <string.h>
+
+#include "lang/object_iterators.h"
+#include "time_report.h"
+
+/*
+ * Wall time spent in the various parts of a setup, enabled with
+ * `muon setup -t`.  Entries are recorded as [kind, name, usec, cached] in
+ * wk->time_report, which is 0 unless the report was requested.  Times are
+ * inclusive, e.g. a subproject's time includes all of its subdirs and
+ * compiler checks.
+ */
+
+#define TIME_REPORT_TOP_N 10
+
+static const struct {
+	const char *name, *json_name;
+} time_report_kind_names[time_report_kind_count] = {
+	[time_report_kind_subproject] = { "subprojects", "subproject" },
+	[time_report_kind_subdir] = { "subdirs", "subdir" },
+	[time_report_kind_dependency] = { "dependency lookups", "dependency" },
+	[time_report_kind_compiler_check] = { "compiler checks", "compiler_check" },
+	[time_report_kind_run_command] = { "run_command", "run_command" },
+};
+
+bool
+time_report_enabled(struct workspace *wk)
+{
+	return !!wk->time_report;
+}
+
+void
+time_report_start(struct workspace *wk, struct timer *t)
+{
+	if (!wk->time_report) {
+		return;
+	}
+
+	timer_start(t);
+}
+
+void
+time_report_end(struct workspace *wk, struct timer *t, enum time_report_kind kind, obj name)
+{
+	if (!wk->time_report) {
+		return;
+	}
+
+	time_report_push(wk, kind, name, timer_read(t), time_report_cached_na);
+}
+
+void
+time_report_push(struct workspace *wk, enum time_report_kind kind, obj name, float dur, enum time_report_cached cached)
+{
+	if (!wk->time_report) {
+		return;
+	}
+
+	// Strip terminal escapes, e.g. from compiler check log messages
+	const struct str *s = get_str(wk, name);
+	if (memchr(s->s, '\033', s->len)) {
+		SBUF(buf);
+		uint32_t i;
+		for (i = 0; i < s->len; ++i) {
+			if (s->s[i] == '\033' && i + 1 < s->len && s->s[i + 1] == '[') {
+				for (i += 2; i < s->len && s->s[i] != 'm'; ++i) {
+				}
+				continue;
+			}
+
+			sbuf_push(wk, &buf, s->s[i]);
+		}
+
+		name = make_strn(wk, buf.buf, buf.len);
+	}
+
+	obj entry;
+	make_obj(wk, &entry, obj_array);
+	obj_array_push(wk, entry, make_number(wk, kind));
+	obj_array_push(wk, entry, name);
+	obj_array_push(wk, entry, make_number(wk, (int64_t)(dur * 1e6f)));
+	obj_array_push(wk, entry, make_number(wk, cached));
+	obj_array_push(wk, wk->time_report, entry);
+}
+
+static int64_t
+time_report_entry_num(struct workspace *wk, obj entry, uint32_t i)
+{
+	obj v;
+	obj_array_index(wk, entry, i, &v);
+	return get_obj_number(wk, v);
+}
+
+static int32_t
+time_report_compare(struct workspace *wk, void *_ctx, obj a, obj b)
+{
+	int64_t ua = time_report_entry_num(wk, a, 2), ub = time_report_entry_num(wk, b, 2);
+
+	if (ua > ub) {
+		return -1;
+	} else if (ua < ub) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+void
+time_report_print(struct workspace *wk, FILE *out)
+{
+	if (!wk->time_report) {
+		return;
+	}
+
+	obj sorted;
+	obj_array_sort(wk, NULL, wk->time_report, time_report_compare, &sorted);
+
+	fprintf(out, "time report:\n");
+
+	uint32_t kind;
+	for (kind = 0; kind < time_report_kind_count; ++kind) {
+		uint32_t count = 0, hits = 0;
+		int64_t total = 0;
+		obj entry;
+
+		obj_array_for(wk, sorted, entry) {
+			if (time_report_entry_num(wk, entry, 0) != kind) {
+				continue;
+			}
+
+			++count;
+			total += time_report_entry_num(wk, entry, 2);
+			if (time_report_entry_num(wk, entry, 3) == time_report_cached_hit) {
+				++hits;
+			}
+		}
+
+		if (!count) {
+			continue;
+		}
+
+		fprintf(out, "- %s: %d in %.3fs", time_report_kind_names[kind].name, count, (double)total / 1e6);
+		if (kind == time_report_kind_compiler_check || kind == time_report_kind_dependency) {
+			fprintf(out, ", %d cached", hits);
+		}
+		fprintf(out, "\n");
+
+		uint32_t printed = 0;
+		obj_array_for(wk, sorted, entry) {
+			if (time_report_entry_num(wk, entry, 0) != kind) {
+				continue;
+			} else if (printed >= TIME_REPORT_TOP_N) {
+				fprintf(out, "    ... %d more\n", count - printed);
+				break;
+			}
+
+			obj name;
+			obj_array_index(wk, entry, 1, &name);
+			fprintf(out, "    %8.3fs %s", (double)time_report_entry_num(wk, entry, 2) / 1e6, get_cstr(wk, name));
+			if (time_report_entry_num(wk, entry, 3) == time_report_cached_hit) {
+				fprintf(out, " (cached)");
+			}
+			fprintf(out, "\n");
+			++printed;
+		}
+	}
+}
+
+bool
+time_report_dump_json(struct workspace *wk, void *_ctx, FILE *out)
+{
+	const char *cached_str[] = {
+		[time_report_cached_na] = "null",
+		[time_report_cached_hit] = "true",
+		[time_report_cached_miss] = "false",
+	};
+
+	SBUF(data);
+	sbuf_pushs(wk, &data, "[");
+
+	bool first = true;
+	obj entry;
+	obj_array_for(wk, wk->time_report, entry) {
+		obj name;
+		obj_array_index(wk, entry, 1, &name);
+		const struct str *s = get_str(wk, name);
+
+		if (!first) {
+			sbuf_push(wk, &data, ',');
+		}
+		first = false;
+
+		sbuf_pushf(wk,
+			&data,
+			"{\"kind\":\"%s\",\"name\":\"",
+			time_report_kind_names[time_report_entry_num(wk, entry, 0)].json_name);
+		sbuf_push_json_escaped(wk, &data, s->s, s->len);
+		sbuf_pushf(wk,
+			&data,
+			"\",\"duration\":%f,\"cached\":%s}",
+			(double)time_report_entry_num(wk, entry, 2) / 1e6,
+			cached_str[time_report_entry_num(wk, entry, 3)]);
+	}
+
+	sbuf_pushs(wk, &data, "]\n");
+
+	return fwrite(data.buf, 1, data.len, out) == data.len;
+}
@@ -13,12 +13,15 @@
 #include "external/libcurl.h"
 #include "formats/ini.h"
 #include "lang/eval.h"
+#include "lang/object_iterators.h"
 #include "lang/workspace.h"
 #include "log.h"
 #include "platform/filesystem.h"
 #include "platform/mem.h"
+#include "platform/os.h"
 #include "platform/path.h"
 #include "platform/run_cmd.h"
+#include "setup_cache.h"
 #include "sha_256.h"
 #include "wrap.h"
 
@@ -134,6 +137,7 @@ struct wrap_parse_provides_ctx {
 	obj add_provides_tgt;
 	struct source *src;
 	struct source_location location;
+	bool overridden;
 };
 
 static void
@@ -151,6 +155,7 @@ wrap_check_provide_duplication(struct workspace *wk, struct wrap_parse_provides_
 			val);
 
 		error_message(ctx->src, ctx->location, log_warn, buf);
+		ctx->overridden = true;
 	}
 }
 
@@ -234,18 +239,22 @@ wrap_parse_provides_cb(void *_ctx,
 }
 
 static bool
-checksum(const uint8_t *file_buf, uint64_t len, const char *sha256)
+checksum_valid(const char *sha256)
 {
-	char buf[3] = { 0 };
-	uint32_t i;
-	uint8_t b, hash[32];
-
 	if (strlen(sha256) != 64) {
 		LOG_E("checksum '%s' is not 64 characters long", sha256);
 		return false;
 	}
 
-	calc_sha_256(hash, file_buf, len);
+	return true;
+}
+
+static bool
+checksum_compare(const uint8_t hash[SHA_256_HASH_SIZE], const char *sha256)
+{
+	char buf[3] = { 0 };
+	uint32_t i;
+	uint8_t b;
 
 	for (i = 0; i < 64; i += 2) {
 		memcpy(buf, &sha256[i], 2);
@@ -259,39 +268,307 @@ checksum(const uint8_t *file_buf, uint64_t len, const char *sha256)
 	return true;
 }
 
+/*
+ * Archives are hashed while they are being extracted, reading them either
+ * from a local file or directly from the network.  Extraction happens in a
+ * temporary directory whose contents are only moved into place once the
+ * checksum has been verified.
+ */
+struct checksum_extract_ctx {
+	struct muon_curl_stream *stream;
+	FILE *f;
+	struct sha_256 sha_256;
+	uint8_t hash[SHA_256_HASH_SIZE];
+	uint8_t buf[BUF_SIZE_32k];
+};
+
+static int64_t
+checksum_extract_read(void *_ctx, const void **buf)
+{
+	struct checksum_extract_ctx *ctx = _ctx;
+	int64_t len;
+
+	if (ctx->stream) {
+		len = muon_curl_stream_read(ctx->stream, buf);
+	} else {
+		len = fread(ctx->buf, 1, sizeof(ctx->buf), ctx->f);
+		if (ferror(ctx->f)) {
+			LOG_E("failed to read archive");
+			return -1;
+		}
+		*buf = ctx->buf;
+	}
+
+	if (len > 0) {
+		sha_256_write(&ctx->sha_256, *buf, len);
+	}
+
+	return len;
+}
+
+struct move_tree_ctx {
+	const char *src, *dest;
+};
+
+static bool move_tree(const char *src, const char *dest);
+
+static enum iteration_result
+move_tree_iter(void *_ctx, const char *name)
+{
+	struct move_tree_ctx *ctx = _ctx;
+	enum iteration_result ret = ir_err;
+	SBUF_manual(src);
+	SBUF_manual(dest);
+
+	path_join(NULL, &src, ctx->src, name);
+	path_join(NULL, &dest, ctx->dest, name);
+
+	if (!fs_symlink_exists(src.buf) && fs_dir_exists(src.buf) && !fs_symlink_exists(dest.buf)
+		&& fs_dir_exists(dest.buf)) {
+		// Merge into existing directories, e.g. when applying a patch
+		// archive on top of the extracted source.
+		if (!move_tree(src.buf, dest.buf) || !fs_rmdir(src.buf, false)) {
+			goto ret;
+		}
+	} else if (!fs_rename(src.buf, dest.buf)) {
+		goto ret;
+	}
+
+	ret = ir_cont;
+ret:
+	sbuf_destroy(&src);
+	sbuf_destroy(&dest);
+	return ret;
+}
+
 static bool
-checksum_extract(const char *buf, size_t len, const char *sha256, const char *dest_dir)
+move_tree(const char *src, const char *dest)
 {
-	if (sha256 && !checksum((const uint8_t *)buf, len, sha256)) {
-		return false;
-	} else if (!muon_archive_extract(buf, len, dest_dir)) {
+	struct move_tree_ctx ctx = { .src = src, .dest = dest };
+	return fs_dir_foreach(src, &ctx, move_tree_iter);
+}
+
+static bool
+checksum_extract(struct checksum_extract_ctx *ctx, const char *filename, const char *sha256, const char *dest_dir)
+{
+	bool res = false;
+	SBUF_manual(tmp_dir);
+
+	path_join(NULL, &tmp_dir, dest_dir, ".muon-extract-");
+	sbuf_pushs(NULL, &tmp_dir, filename);
+
+	if (fs_dir_exists(tmp_dir.buf)) {
+		if (!fs_rmdir_recursive(tmp_dir.buf, true)) {
+			goto ret;
+		}
+	} else if (!fs_mkdir_p(tmp_dir.buf)) {
+		goto ret;
+	}
+
+	sha_256_init(&ctx->sha_256, ctx->hash);
+
+	if (!muon_archive_extract(checksum_extract_read, ctx, tmp_dir.buf)) {
+		goto cleanup;
+	}
+
+	// The archive reader may stop before the end of the input, but the
+	// checksum covers all of it.
+	int64_t len;
+	const void *buf;
+	while ((len = checksum_extract_read(ctx, &buf)) > 0) {
+	}
+
+	if (len < 0) {
+		goto cleanup;
+	}
+
+	sha_256_close(&ctx->sha_256);
+
+	if (sha256 && !checksum_compare(ctx->hash, sha256)) {
+		goto cleanup;
+	}
+
+	if (!move_tree(tmp_dir.buf, dest_dir)) {
+		goto cleanup;
+	}
+
+	res = true;
+cleanup:
+	if (fs_rmdir_recursive(tmp_dir.buf, true)) {
+		fs_rmdir(tmp_dir.buf, true);
+	}
+ret:
+	sbuf_destroy(&tmp_dir);
+	return res;
+}
+
+static bool
+checksum_extract_file(const char *path, const char *filename, const char *sha256, const char *dest_dir)
+{
+	struct checksum_extract_ctx *ctx = z_calloc(1, sizeof(*ctx));
+	bool res = false;
+
+	if (sha256 && !checksum_valid(sha256)) {
+		goto ret;
+	}
+
+	if (!(ctx->f = fs_fopen(path, "rb"))) {
+		goto ret;
+	}
+
+	res = checksum_extract(ctx, filename, sha256, dest_dir);
+
+	if (!fs_fclose(ctx->f)) {
+		res = false;
+	}
+ret:
+	z_free(ctx);
+	return res;
+}
+
+static bool
+fetch_checksum_extract(const char *src, const char *filename, const char *sha256, const char *dest_dir)
+{
+	struct checksum_extract_ctx *ctx = z_calloc(1, sizeof(*ctx));
+	bool res = false;
+
+	if (sha256 && !checksum_valid(sha256)) {
+		goto ret;
+	}
+
+	muon_curl_init();
+
+	if (!(ctx->stream = muon_curl_stream_open(src))) {
+		goto deinit;
+	}
+
+	res = checksum_extract(ctx, filename, sha256, dest_dir);
+
+	if (!muon_curl_stream_close(ctx->stream)) {
+		res = false;
+	}
+deinit:
+	muon_curl_deinit();
+ret:
+	z_free(ctx);
+	return res;
+}
+
+/*
+ * Archives with a hash are extracted once into a shared, content-addressed
+ * cache and copied into place from there, so that other checkouts neither
+ * download nor extract the same archive again.  Each entry, <cache>/<sha256>,
+ * holds the extracted contents of an archive.  Entries are created by
+ * renaming a fully extracted and verified temporary directory, so they are
+ * always complete even when several processes populate the cache at once.
+ * Files are copied out of the cache, which reflinks them on filesystems that
+ * support it, so that editing a subproject can never modify the cache.
+ *
+ * The cache lives in $MUON_WRAP_CACHE_DIR, or in muon/wraps in the user's
+ * cache directory.  Setting MUON_WRAP_CACHE_DIR to an empty string disables
+ * it.
+ */
+static bool
+wrap_cache_path(struct sbuf *buf, const char *sha256)
+{
+	const char *dir;
+
+	if ((dir = getenv("MUON_WRAP_CACHE_DIR"))) {
+		if (!*dir) {
+			return false;
+		}
+
+		path_make_absolute(NULL, buf, dir);
+	} else if ((dir = getenv("XDG_CACHE_HOME")) && *dir) {
+		path_join(NULL, buf, dir, "muon/wraps");
+#ifdef _WIN32
+	} else if ((dir = getenv("LOCALAPPDATA")) && *dir) {
+		path_join(NULL, buf, dir, "muon/wraps");
+#else
+	} else if ((dir = getenv("HOME")) && *dir) {
+		path_join(NULL, buf, dir, ".cache/muon/wraps");
+#endif
+	} else {
 		return false;
 	}
 
+	path_push(NULL, buf, sha256);
+
+	struct str key = { .s = &buf->buf[buf->len - 64], .len = 64 };
+	str_to_lower(&key);
 	return true;
 }
 
 static bool
-fetch_checksum_extract(const char *src, const char *dest, const char *sha256, const char *dest_dir)
+wrap_cache_hit(const char *sha256)
 {
 	bool res = false;
-	uint8_t *dlbuf = NULL;
-	uint64_t dlbuf_len;
+	SBUF_manual(cache_path);
 
-	muon_curl_init();
+	if (sha256 && strlen(sha256) == 64 && wrap_cache_path(&cache_path, sha256)) {
+		res = fs_dir_exists(cache_path.buf);
+	}
+
+	sbuf_destroy(&cache_path);
+	return res;
+}
+
+static bool
+wrap_cache_checksum_extract(const char *src, bool fetch, const char *filename, const char *sha256, const char *dest_dir)
+{
+	bool res = false;
+	SBUF_manual(cache_path);
+	SBUF_manual(tmp_dir);
 
-	if (!muon_curl_fetch(src, &dlbuf, &dlbuf_len)) {
+	if (!checksum_valid(sha256)) {
 		goto ret;
-	} else if (!checksum_extract((const char *)dlbuf, dlbuf_len, sha256, dest_dir)) {
+	}
+
+	if (!wrap_cache_path(&cache_path, sha256)) {
+		if (fetch) {
+			res = fetch_checksum_extract(src, filename, sha256, dest_dir);
+		} else {
+			res = checksum_extract_file(src, filename, sha256, dest_dir);
+		}
+		goto ret;
+	}
+
+	if (!fs_dir_exists(cache_path.buf)) {
+		sbuf_pushf(NULL, &tmp_dir, "%s.tmp-%d", cache_path.buf, os_getpid());
+
+		if (!fs_mkdir_p(tmp_dir.buf)) {
+			goto ret;
+		}
+
+		bool ok;
+		if (fetch) {
+			ok = fetch_checksum_extract(src, filename, sha256, tmp_dir.buf);
+		} else {
+			ok = checksum_extract_file(src, filename, sha256, tmp_dir.buf);
+		}
+
+		// Another process may have populated the entry in the meantime
+		if (ok && !fs_dir_exists(cache_path.buf)) {
+			ok = fs_rename(tmp_dir.buf, cache_path.buf);
+		}
+
+		if (fs_dir_exists(tmp_dir.buf) && fs_rmdir_recursive(tmp_dir.buf, true)) {
+			fs_rmdir(tmp_dir.buf, true);
+		}
+
+		if (!ok) {
+			goto ret;
+		}
+	}
+
+	if (!fs_copy_dir(cache_path.buf, dest_dir)) {
 		goto ret;
 	}
 
 	res = true;
 ret:
-	if (dlbuf) {
-		z_free(dlbuf);
-	}
-	muon_curl_deinit();
+	sbuf_destroy(&tmp_dir);
+	sbuf_destroy(&cache_path);
 	return res;
 }
 
@@ -318,19 +595,11 @@ wrap_download_or_check_packagefiles(const char *filename,
 			LOG_W("url specified, but local file '%s' is being used", source_path.buf);
 		}
 
-		struct source src = { 0 };
-		if (!fs_read_entire_file(source_path.buf, &src)) {
-			goto ret;
-		}
-
-		if (!checksum_extract(src.src, src.len, hash, dest_dir)) {
-			fs_source_destroy(&src);
-			goto ret;
+		if (hash) {
+			res = wrap_cache_checksum_extract(source_path.buf, false, filename, hash, dest_dir);
+		} else {
+			res = checksum_extract_file(source_path.buf, filename, hash, dest_dir);
 		}
-
-		fs_source_destroy(&src);
-
-		res = true;
 	} else if (fs_dir_exists(source_path.buf)) {
 		if (url) {
 			LOG_W("url specified, but local directory '%s' is being used", source_path.buf);
@@ -342,11 +611,13 @@ wrap_download_or_check_packagefiles(const char *filename,
 
 		res = true;
 	} else if (url) {
-		if (!download) {
-			LOG_E("wrap downloading is disabled");
-			goto ret;
+		if (hash && (download || wrap_cache_hit(hash))) {
+			res = wrap_cache_checksum_extract(url, true, filename, hash, dest_dir);
+		} else if (!download) {
+			LOG_E("wrap downloading is disabled and '%s' is not in the wrap cache", filename);
+		} else {
+			res = fetch_checksum_extract(url, filename, hash, dest_dir);
 		}
-		res = fetch_checksum_extract(url, filename, hash, dest_dir);
 	} else {
 		LOG_E("no url specified, but '%s' is not a file or directory", source_path.buf);
 	}
@@ -692,8 +963,7 @@ ret:
 
 struct wrap_load_all_ctx {
 	struct workspace *wk;
-	const char *subprojects;
-	struct sbuf *path;
+	obj files;
 };
 
 static enum iteration_result
@@ -705,61 +975,115 @@ wrap_load_all_iter(void *_ctx, const char *file)
 		return ir_cont;
 	}
 
-	path_join(ctx->wk, ctx->path, ctx->subprojects, file);
-
-	if (!fs_file_exists(ctx->path->buf)) {
-		return ir_cont;
-	}
+	obj_array_push(ctx->wk, ctx->files, make_str(ctx->wk, file));
+	return ir_cont;
+}
 
+static bool
+wrap_load_provides(struct workspace *wk, const char *path, bool *overridden)
+{
 	struct wrap wrap = { 0 };
-	if (!wrap_parse(ctx->path->buf, &wrap)) {
-		return ir_err;
+	if (!wrap_parse(path, &wrap)) {
+		return false;
 	}
 
-	enum iteration_result ret = ir_err;
+	bool ret = false;
 
 	if (!wrap.has_provides) {
-		ret = ir_cont;
+		ret = true;
 		goto ret;
 	}
 
 	struct wrap_parse_provides_ctx wp_ctx = {
-		.wk = ctx->wk,
+		.wk = wk,
 		.wrap = &wrap,
-		.wrap_name = make_str(ctx->wk, wrap.name.buf),
+		.wrap_name = make_str(wk, wrap.name.buf),
 	};
 
-	make_obj(ctx->wk, &wp_ctx.wrap_name_arr, obj_array);
-	obj_array_push(ctx->wk, wp_ctx.wrap_name_arr, wp_ctx.wrap_name);
+	make_obj(wk, &wp_ctx.wrap_name_arr, obj_array);
+	obj_array_push(wk, wp_ctx.wrap_name_arr, wp_ctx.wrap_name);
 
-	if (!ini_reparse(ctx->path->buf, &wrap.src, wrap.buf, wrap_parse_provides_cb, &wp_ctx)) {
+	if (!ini_reparse(path, &wrap.src, wrap.buf, wrap_parse_provides_cb, &wp_ctx)) {
 		goto ret;
 	}
 
-	ret = ir_cont;
+	*overridden |= wp_ctx.overridden;
+	ret = true;
 ret:
 	wrap_destroy(&wrap);
 	return ret;
 }
 
+/*
+ * The provides table only depends on the wrap files present in the
+ * subprojects dir, so it is stored in the setup cache along with the mtime
+ * of the directory (which changes when wraps are added or removed) and of
+ * every wrap file.  Wraps are parsed in name order, so that a provide
+ * overridden by another wrap resolves the same way regardless of directory
+ * order.
+ */
 bool
 wrap_load_all_provides(struct workspace *wk, const char *subprojects)
 {
-	SBUF(wrap_path_buf);
+	if (!fs_dir_exists(subprojects)) {
+		return true;
+	}
 
-	struct wrap_load_all_ctx ctx = {
-		.wk = wk,
-		.subprojects = subprojects,
-		.path = &wrap_path_buf,
-	};
+	struct project *proj = current_project(wk);
+	obj key = make_strf(wk, "wrap_provides:%s", subprojects), cached;
+	if (setup_cache_get(wk, key, &cached)) {
+		obj deps, exes, k, v;
+		obj_array_index(wk, cached, 0, &deps);
+		obj_array_index(wk, cached, 1, &exes);
 
-	if (!fs_dir_exists(subprojects)) {
+		obj_dict_for(wk, deps, k, v) {
+			obj_dict_set(wk, proj->wrap_provides_deps, k, v);
+		}
+
+		obj_dict_for(wk, exes, k, v) {
+			obj_dict_set(wk, proj->wrap_provides_exes, k, v);
+		}
 		return true;
 	}
 
+	struct wrap_load_all_ctx ctx = { .wk = wk };
+	make_obj(wk, &ctx.files, obj_array);
+
 	if (!fs_dir_foreach(subprojects, &ctx, wrap_load_all_iter)) {
 		return false;
 	}
 
+	obj files, file, stamps;
+	obj_array_sort(wk, NULL, ctx.files, obj_array_sort_by_str, &files);
+
+	make_obj(wk, &stamps, obj_array);
+	obj_array_push(wk, stamps, make_str(wk, subprojects));
+
+	bool overridden = false;
+	SBUF(path);
+	obj_array_for(wk, files, file) {
+		path_join(wk, &path, subprojects, get_cstr(wk, file));
+
+		if (!fs_file_exists(path.buf)) {
+			continue;
+		}
+
+		obj_array_push(wk, stamps, make_str(wk, path.buf));
+
+		if (!wrap_load_provides(wk, path.buf, &overridden)) {
+			return false;
+		}
+	}
+
+	// Don't cache a table that produced warnings, so that they are shown
+	// again on the next setup.
+	if (!overridden) {
+		obj val;
+		make_obj(wk, &val, obj_array);
+		obj_array_push(wk, val, proj->wrap_provides_deps);
+		obj_array_push(wk, val, proj->wrap_provides_exes);
+		setup_cache_set(wk, key, stamps, val);
+	}
+
 	return true;
 }
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+/*
+ * Measures the throughput of each sha_256 implementation supported by the
+ * current cpu, both for large inputs and for the short inputs that make up
+ * compiler check cache keys.
+ */
+
+#include "compat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sha_256.h"
+
+#define BENCH_BUF_SIZE (1 << 20)
+#define BENCH_BYTES (64u << 20)
+
+static double
+bench(const uint8_t *buf, size_t len, uint8_t hash[SHA_256_HASH_SIZE])
+{
+	size_t i, n = BENCH_BYTES / len;
+
+	clock_t start = clock();
+	for (i = 0; i < n; ++i) {
+		calc_sha_256(hash, buf, len);
+	}
+	double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	return secs > 0 ? (double)(n * len) / secs / (1 << 20) : 0;
+}
+
+int
+main(void)
+{
+	uint8_t *buf = malloc(BENCH_BUF_SIZE);
+	uint8_t ref[SHA_256_HASH_SIZE], hash[SHA_256_HASH_SIZE];
+	const size_t lens[] = { BENCH_BUF_SIZE, 256 };
+	uint32_t i, j;
+	int ret = 0;
+
+	if (!buf) {
+		return 1;
+	}
+
+	for (i = 0; i < BENCH_BUF_SIZE; ++i) {
+		buf[i] = (uint8_t)(i * 2654435761u >> 24);
+	}
+
+	sha_256_impl_select(sha_256_impl_generic);
+	calc_sha_256(ref, buf, BENCH_BUF_SIZE);
+
+	for (i = 0; i < sha_256_impl_count; ++i) {
+		if (!sha_256_impl_select(i)) {
+			continue;
+		}
+
+		printf("%-14s", sha_256_impl_name(i));
+		for (j = 0; j < sizeof(lens) / sizeof(*lens); ++j) {
+			printf(" %8zu bytes: %8.1f MiB/s", lens[j], bench(buf, lens[j], hash));
+		}
+		printf("\n");
+
+		calc_sha_256(hash, buf, BENCH_BUF_SIZE);
+		if (memcmp(hash, ref, sizeof(ref)) != 0) {
+			printf("%s: hash mismatch\n", sha_256_impl_name(i));
+			ret = 1;
+		}
+	}
+
+	free(buf);
+	return ret;
+}
@@ -0,0 +1,10 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+int lib(void);
+
+int
+main(void)
+{
+	return lib() == 3 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIB_VALUE
+#define LIB_VALUE 0
+#endif
+
+int
+lib_value(void)
+{
+	return LIB_VALUE;
+}
@@ -0,0 +1,16 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdlib.h>
+
+int lib_value(void);
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		return 1;
+	}
+
+	return lib_value() != atoi(argv[1]);
+}
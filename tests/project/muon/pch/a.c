@@ -0,0 +1,8 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+int
+a(void)
+{
+	return PCH_VALUE + (int)sizeof(NULL) - (int)sizeof(void *);
+}
@@ -0,0 +1,10 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+int a(void);
+
+int
+main(void)
+{
+	return a() == PCH_VALUE ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+extern "C" {
+int a(void);
+int b(void);
+int c(void);
+}
+
+int
+main(void)
+{
+	return a() + b() + c() == 3 * PCH_VALUE ? 0 : 1;
+}
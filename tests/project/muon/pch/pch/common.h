@@ -0,0 +1,6 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stddef.h>
+
+#define PCH_VALUE 1
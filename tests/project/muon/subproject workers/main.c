@@ -0,0 +1,8 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+int
+main(void)
+{
+	return A + B == 3 ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+static int
+value(void)
+{
+	return 1;
+}
+
+int
+a(void)
+{
+	return value();
+}
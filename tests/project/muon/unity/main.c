@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: Stone Tickle <lattis@mochiro.moe>
+// SPDX-License-Identifier: GPL-3.0-only
+
+int a(void);
+int b(void);
+int c(void);
+int gen(void);
+
+int
+main(void)
+{
+	return a() + b() + c() + gen() == 10 ? 0 : 1;
+}
@@ -9,6 +9,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+// FNV-1a, must match embedded_hash in src/embedded.c
+static uint32_t
+embedded_hash(const char *s)
+{
+	uint32_t h = 2166136261u;
+	for (; *s; ++s) {
+		h ^= (uint8_t)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
 
 static bool
 embed(const char *path, const char *embedded_name)
@@ -45,10 +58,7 @@ main(int argc, char *const argv[])
 	assert(argc >= 1);
 	assert(((argc - 1) & 1) == 0 && "you must pass an even number of arguments");
 
-	printf("uint32_t embedded_len = %d;\n"
-	       "\n"
-	       "static struct embedded_file embedded[] = {\n",
-		(argc - 1) / 2);
+	printf("static struct embedded_file embedded[] = {\n");
 
 	uint32_t i;
 	for (i = 1; i < (uint32_t)argc; i += 2) {
@@ -57,5 +67,35 @@ main(int argc, char *const argv[])
 		}
 	}
 
-	printf("};\n");
+	printf("};\n\n");
+
+	// Open addressed hash table of indices into embedded, offset by one so
+	// that 0 marks an empty bucket.  It is kept at most half full.
+	uint32_t n = (argc - 1) / 2, size = 1, *buckets;
+	while (size < n * 2) {
+		size <<= 1;
+	}
+
+	if (!(buckets = calloc(size, sizeof(uint32_t)))) {
+		fprintf(stderr, "allocation failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < n; ++i) {
+		uint32_t b = embedded_hash(argv[2 + i * 2]) & (size - 1);
+		while (buckets[b]) {
+			b = (b + 1) & (size - 1);
+		}
+		buckets[b] = i + 1;
+	}
+
+	printf("static const uint32_t embedded_buckets_len = %d;\n"
+	       "static const uint32_t embedded_buckets[] = {",
+		size);
+	for (i = 0; i < size; ++i) {
+		printf("%s%d", i ? ", " : " ", buckets[i]);
+	}
+	printf(" };\n");
+
+	free(buckets);
 }